@@ -6,6 +6,43 @@
 #include <memory>
 #include <cmath>
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <tuple>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <stdexcept>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define SAPPER_IO_URING 1
+#endif
+#endif
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 // Вперёд объявляем Game, чтобы состояния могли на него ссылаться
 class Game;
 
@@ -106,6 +143,787 @@ class IBoardGenerator {
 public:
     virtual ~IBoardGenerator() = default;
     virtual void generate(Game& game, int safeX, int safeY) = 0;
+    // Для воспроизводимых партий (симулятор, анализ); по умолчанию ничего
+    virtual void reseed(std::uint32_t) {}
+};
+
+// MEMORY USAGE — сколько памяти держит подсистема, деревом:
+// live — выделено сейчас, peak — максимум, который видел владелец узла,
+// дети — составные части (их байты входят в родителя).
+// Контейнеры считаются по ёмкости (выделено, а не занято); объекты в куче —
+// с примерной служебной частью malloc.
+
+struct MemoryUsage {
+    std::string name;
+    size_t live = 0, peak = 0;
+    std::vector<MemoryUsage> children;
+
+    MemoryUsage() = default;
+    MemoryUsage(std::string n, size_t bytes) : name(std::move(n)), live(bytes), peak(bytes) {}
+
+    MemoryUsage& add(MemoryUsage child) {
+        live += child.live;
+        peak = std::max(peak, live);
+        children.push_back(std::move(child));
+        return *this;
+    }
+
+    // Пик с учётом прошлых замеров владельца (tracked хранит владелец)
+    MemoryUsage& track(size_t& tracked) {
+        tracked = std::max({tracked, live, peak});
+        peak = tracked;
+        return *this;
+    }
+
+    std::string toJson() const {
+        std::string s = "{\"name\":\"" + name + "\",\"live\":" + std::to_string(live)
+                      + ",\"peak\":" + std::to_string(peak);
+        if (!children.empty()) {
+            s += ",\"children\":[";
+            for (size_t i = 0; i < children.size(); i++) s += (i ? "," : "") + children[i].toJson();
+            s += "]";
+        }
+        return s + "}";
+    }
+
+    // Строки "имя  живые КБ (пик КБ)" с отступом по глубине — для отладочного слоя
+    void describe(std::string& out, int maxDepth = 2, int depth = 0) const {
+        char line[128];
+        std::snprintf(line, sizeof(line), "%*s%-*s %9.1f KB (peak %.1f)\n", depth * 2, "",
+                      32 - depth * 2, name.c_str(), live / 1024.0, peak / 1024.0);
+        out += line;
+        if (depth < maxDepth)
+            for (const MemoryUsage& c : children) c.describe(out, maxDepth, depth + 1);
+    }
+};
+
+template <class T>
+static size_t vectorBytes(const std::vector<T>& v) { return v.capacity() * sizeof(T); }
+
+// Блок кучи под объект размера n: заголовок 8 байт, шаг 16, не меньше 32 (как в glibc)
+static size_t heapBlockBytes(size_t n) { return std::max<size_t>(32, (n + 8 + 15) / 16 * 16); }
+
+// Память процесса целиком (RSS и его пик); 0 — система не сообщает
+static void processMemory(size_t& rss, size_t& peakRss) {
+    rss = peakRss = 0;
+#if defined(__linux__)
+    std::ifstream f("/proc/self/status");
+    std::string key;
+    size_t kb = 0;
+    while (f >> key) {
+        if (key == "VmRSS:" && f >> kb) rss = kb * 1024;
+        else if (key == "VmHWM:" && f >> kb) peakRss = kb * 1024;
+        f.ignore(1 << 10, '\n');
+    }
+#endif
+}
+
+// Корень дерева: процесс; то, что не учтено подсистемами, — узел "other"
+static MemoryUsage processMemoryUsage(std::vector<MemoryUsage> parts) {
+    MemoryUsage root("process", 0);
+    for (MemoryUsage& p : parts) root.add(std::move(p));
+    size_t rss, peakRss;
+    processMemory(rss, peakRss);
+    if (rss > root.live) root.add(MemoryUsage("other (libraries, fonts, heap)", rss - root.live));
+    root.peak = std::max(root.peak, peakRss);
+    return root;
+}
+
+// MEMORY BUDGET — жёсткий предел памяти процесса (--memory-limit МБ).
+// Владелец периодически собирает дерево памяти и вызывает enforce: если
+// процесс больше предела, кэши сбрасываются по порядку регистрации
+// (сначала те, что дешевле восстановить), пока не уложимся.
+
+class MemoryBudget {
+    struct Cache {
+        std::string name;
+        std::function<size_t()> release; // вернёт освобождённые байты
+    };
+    size_t limit;
+    std::vector<Cache> caches;
+    size_t evictions = 0, freedTotal = 0;
+public:
+    explicit MemoryBudget(size_t limitBytes = 0) : limit(limitBytes) {}
+
+    void addCache(std::string name, std::function<size_t()> release) {
+        caches.push_back({std::move(name), std::move(release)});
+    }
+
+    size_t limitBytes() const { return limit; }
+    size_t evictionCount() const { return evictions; }
+    size_t freedBytes() const { return freedTotal; }
+
+    // Вернёт, сколько освобождено сейчас
+    size_t enforce(const MemoryUsage& usage) {
+        if (limit == 0 || usage.live <= limit) return 0;
+        size_t freed = 0;
+        for (Cache& c : caches) {
+            size_t f = c.release();
+            if (f == 0) continue;
+            freed += f;
+            evictions++;
+            if (usage.live - std::min(usage.live, freed) <= limit) break;
+        }
+        freedTotal += freed;
+        return freed;
+    }
+};
+
+// Индексированное множество клеток: вставка/удаление за O(1),
+// обход за O(размера), а не за O(W*H)
+class CellSet {
+    std::vector<int> items_;
+    std::vector<int> pos_; // позиция клетки в items_ или -1
+public:
+    void reset(int cells) { items_.clear(); pos_.assign(cells, -1); }
+
+    bool contains(int i) const { return pos_[i] >= 0; }
+    void insert(int i) {
+        if (pos_[i] >= 0) return;
+        pos_[i] = (int)items_.size();
+        items_.push_back(i);
+    }
+    void erase(int i) {
+        int p = pos_[i];
+        if (p < 0) return;
+        items_[p] = items_.back();
+        pos_[items_[p]] = p;
+        items_.pop_back();
+        pos_[i] = -1;
+    }
+
+    const std::vector<int>& items() const { return items_; }
+    size_t size() const { return items_.size(); }
+    size_t bytes() const { return vectorBytes(items_) + vectorBytes(pos_); }
+};
+
+// EVENT BUS — PATTERN: Observer (события партии для подписчиков:
+// запись повторов, статистика, звук, сеть).
+// Клетки события — индексы y*W+x, срез журнала changeLog без копирования;
+// срез действителен только во время вызова. Публикация не выделяет память,
+// а без подписчиков стоит одну проверку.
+
+enum class GameEventType : unsigned char { Reset, CellsOpened, FlagChanged, CellsChanged, Won, Lost };
+
+struct GameEvent {
+    GameEventType type = GameEventType::Reset;
+    int x = -1, y = -1;          // клетка, с которой всё началось; Lost — взорвавшаяся мина
+    const int* cells = nullptr;  // CellsOpened — все открытые клетки (и проём целиком);
+                                 // CellsChanged — всё, что изменила пачка действий
+    size_t count = 0;
+    bool flagged = false;        // FlagChanged: флаг теперь стоит
+};
+
+class IGameListener {
+public:
+    virtual ~IGameListener() = default;
+    virtual void onGameEvent(const Game& game, const GameEvent& e) = 0;
+};
+
+// Подписчики, известные при компиляции: один вход в шине, а внутри —
+// прямые вызовы (типам не нужно наследовать IGameListener)
+template <class... Ls>
+class GameListenerGroup final : public IGameListener {
+    std::tuple<Ls&...> listeners;
+public:
+    explicit GameListenerGroup(Ls&... ls) : listeners(ls...) {}
+    void onGameEvent(const Game& game, const GameEvent& e) override {
+        std::apply([&](auto&... l) { (l.onGameEvent(game, e), ...); }, listeners);
+    }
+};
+
+// Подписка на время выполнения: фиксированный массив, без выделений.
+// Подписывать и отписывать внутри обработчика нельзя.
+class GameEventBus {
+public:
+    static constexpr int kMaxListeners = 8;
+
+    bool active() const { return count_ > 0; }
+
+    bool subscribe(IGameListener* l) {
+        for (int i = 0; i < count_; i++) if (list_[i] == l) return true;
+        if (count_ == kMaxListeners) return false;
+        list_[count_++] = l;
+        return true;
+    }
+
+    void unsubscribe(IGameListener* l) {
+        for (int i = 0; i < count_; i++)
+            if (list_[i] == l) {
+                std::copy(list_.begin() + i + 1, list_.begin() + count_, list_.begin() + i);
+                count_--;
+                return;
+            }
+    }
+
+    void publish(const Game& game, const GameEvent& e) const {
+        for (int i = 0; i < count_; i++) list_[i]->onGameEvent(game, e);
+    }
+
+private:
+    std::array<IGameListener*, kMaxListeners> list_{};
+    int count_ = 0;
+};
+
+// BATCH ACTIONS — несколько действий за один вызов Game::apply
+// (боты, повторы, сетевые клиенты). Chord — открыть соседей открытого числа,
+// если вокруг него уже стоит столько же флагов.
+
+struct GameAction {
+    enum Kind : unsigned char { Reveal, Flag, Chord };
+    Kind kind = Reveal;
+    int  x = 0, y = 0;
+};
+
+// Ignored — ничего не изменилось (клетка вне поля, уже открыта, партия окончена);
+// NotRun — действие после проигрыша в той же пачке
+enum class ActionResult : unsigned char { Ignored, Applied, Lost, NotRun };
+
+struct BatchResult {
+    size_t applied = 0; // действий, изменивших поле (включая проигрышное); Ignored не в счёт
+    bool   lost = false;
+    bool   won = false;
+};
+
+// MEMORY PLACEMENT — где живут большие плоскости поля и данные рабочих потоков.
+// Настройки процесса (Singleton), задаются ключами --huge-pages и --pin-workers:
+//   boardPages — страницы для плоскостей PlaneBoard: обычные, прозрачные
+//                большие (THP, madvise) или явные (MAP_HUGETLB, нужен пул
+//                vm.nr_hugepages; если его нет — THP);
+//   pinWorkers — поток w пула закрепляется за w-м доступным ядром. Данные
+//                потока создаются в нём самом (первое касание), поэтому
+//                на многосокетной машине лежат на узле NUMA своего ядра.
+// Всё это — только Linux; на других системах обычная память и без закрепления.
+
+struct MemoryPlacement {
+    enum class Pages { Normal, Transparent, Explicit };
+    Pages boardPages = Pages::Normal;
+    bool  pinWorkers = false;
+
+    static MemoryPlacement& instance() {
+        static MemoryPlacement m;
+        return m;
+    }
+};
+
+static void pinCurrentThread(unsigned worker) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    int count = CPU_COUNT(&allowed);
+    if (count <= 0) return;
+    int want = (int)(worker % (unsigned)count);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed) || want-- > 0) continue;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+        return;
+    }
+#else
+    (void)worker;
+#endif
+}
+
+// Сколько анонимной памяти процесса сейчас на больших страницах (THP), КБ
+static long anonHugePagesKb() {
+#if defined(__linux__)
+    std::ifstream f("/proc/self/smaps_rollup");
+    std::string key;
+    long kb = 0;
+    while (f >> key) {
+        if (key == "AnonHugePages:") { f >> kb; return kb; }
+        f.ignore(1 << 10, '\n');
+    }
+#endif
+    return 0;
+}
+
+// Буфер плоскости поля. На Linux — отдельное отображение памяти, выровненное
+// на 2 МБ, с выбранным видом страниц; заполнение (первое касание) делает
+// поток, который вызвал assign. Плоскости меньше 2 МБ на обычных страницах
+// (поля Game) — в куче; повторный assign того же размера только заполняет.
+class PlaneBuffer {
+    unsigned char* ptr = nullptr;
+    size_t len = 0;
+    MemoryPlacement::Pages asked = MemoryPlacement::Pages::Normal;
+    MemoryPlacement::Pages got = MemoryPlacement::Pages::Normal;
+    std::vector<unsigned char> buffer;
+#if defined(__linux__)
+    static constexpr size_t kHuge = (size_t)2 << 20;
+    void*  map = nullptr;
+    size_t mapLen = 0;
+#endif
+
+public:
+    PlaneBuffer() = default;
+    PlaneBuffer(const PlaneBuffer&) = delete;
+    PlaneBuffer& operator=(const PlaneBuffer&) = delete;
+    ~PlaneBuffer() { release(); }
+
+    void assign(size_t n, unsigned char value, MemoryPlacement::Pages pages) {
+        if (ptr && n == len && pages == asked) { std::memset(ptr, value, n); return; }
+        release();
+        len = n;
+        asked = pages;
+#if defined(__linux__)
+        if (n == 0) return;
+        if (n < kHuge && pages == MemoryPlacement::Pages::Normal) {
+            buffer.assign(n, value);
+            ptr = buffer.data();
+            return;
+        }
+        size_t rounded = (n + kHuge - 1) / kHuge * kHuge;
+        if (pages == MemoryPlacement::Pages::Explicit) {
+            map = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (map != MAP_FAILED) {
+                mapLen = rounded;
+                got = pages;
+            } else {
+                map = nullptr;
+                pages = MemoryPlacement::Pages::Transparent; // пула больших страниц нет
+            }
+        }
+        if (!map) {
+            // Запас на выравнивание: THP собирается только из выровненных 2 МБ
+            mapLen = rounded + kHuge;
+            map = mmap(nullptr, mapLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (map == MAP_FAILED) { map = nullptr; mapLen = 0; len = 0; throw std::bad_alloc(); }
+            unsigned char* aligned = (unsigned char*)(((std::uintptr_t)map + kHuge - 1) & ~(std::uintptr_t)(kHuge - 1));
+            ptr = aligned;
+            if (pages == MemoryPlacement::Pages::Transparent) madvise(aligned, rounded, MADV_HUGEPAGE);
+            got = pages;
+        } else {
+            ptr = (unsigned char*)map;
+        }
+        std::memset(ptr, value, n);
+#else
+        (void)pages;
+        buffer.assign(n, value);
+        ptr = buffer.data();
+#endif
+    }
+
+    void release() {
+#if defined(__linux__)
+        if (map) munmap(map, mapLen);
+        map = nullptr;
+        mapLen = 0;
+#endif
+        buffer.clear();
+        buffer.shrink_to_fit();
+        ptr = nullptr;
+        len = 0;
+        asked = got = MemoryPlacement::Pages::Normal;
+    }
+
+    unsigned char* data() { return ptr; }
+    const unsigned char* data() const { return ptr; }
+    size_t size() const { return len; }
+    MemoryPlacement::Pages pages() const { return got; }
+};
+
+// VISIBLE BOARD — то, что видит игрок, по байту на клетку:
+// 0..8 — открытое число, VisClosed — закрыто, VisFlag — флаг, VisMine — открытая мина
+
+enum VisibleCode : unsigned char { VisClosed = 9, VisFlag = 10, VisMine = 11 };
+
+static unsigned char visibleCode(const Cell& c) {
+    if (c.state->isFlagged())     return VisFlag;
+    if (!c.state->isOpen())       return VisClosed;
+    if (c.content->isMine())      return VisMine;
+    return (unsigned char)c.content->number();
+}
+
+// BOARD STORAGE — PATTERN: Strategy (как хранятся клетки поля).
+// Правила партии (открытие, проём, флаги, chord, победа и проигрыш) написаны
+// один раз — в PlaneBoard над IBoardStorage; хранилище внедряется при создании,
+// как cellFactory и boardGenerator у Game. Game играет через PlaneBoard, а
+// объекты клеток (State, фабрики) держит как представление для интерфейса,
+// решателя и ботов. Гигантские доски и бенчмарки берут PlaneBoard без Game.
+// Клетка для правил — байт: биты kMine/kOpened/kFlag и число мин вокруг
+// (биты 4..7); хранилище может держать число или считать его на лету.
+
+class IBoardStorage {
+public:
+    enum : unsigned char { kMine = 1, kOpened = 2, kFlag = 4, kNumberShift = 4 };
+
+    virtual ~IBoardStorage() = default;
+    virtual const char* name() const = 0;
+    virtual void reset(int w, int h) = 0;                 // всё закрыто, мин нет
+    virtual unsigned char get(size_t i) const = 0;        // вместе с числом
+    virtual void set(size_t i, unsigned char bits) = 0;   // число в bits не учитывается
+    virtual void minesPlaced() = 0;                       // мины расставлены — числа
+    virtual size_t bytes() const = 0;                     // занятая память
+};
+
+// Числа для байтовых клеток: каждая мина добавляет единицу соседям
+static void addNeighborCounts(unsigned char* cells, int W, int H) {
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++) {
+            if (!(cells[(size_t)y * W + x] & IBoardStorage::kMine)) continue;
+            for (int ny = std::max(0, y - 1); ny <= std::min(H - 1, y + 1); ny++)
+                for (int nx = std::max(0, x - 1); nx <= std::min(W - 1, x + 1); nx++)
+                    if (nx != x || ny != y) cells[(size_t)ny * W + nx] += 1 << IBoardStorage::kNumberShift;
+        }
+}
+
+// Байт на клетку, число хранится; страницы — по MemoryPlacement
+class DenseBoardStorage final : public IBoardStorage {
+    int W = 0, H = 0;
+    MemoryPlacement::Pages pageMode;
+    PlaneBuffer cells;
+public:
+    explicit DenseBoardStorage(MemoryPlacement::Pages pages = MemoryPlacement::instance().boardPages)
+        : pageMode(pages) {}
+
+    const char* name() const override { return "dense"; }
+    void reset(int w, int h) override { W = w; H = h; cells.assign((size_t)w * h, 0, pageMode); }
+    unsigned char get(size_t i) const override { return cells.data()[i]; }
+    void set(size_t i, unsigned char bits) override {
+        unsigned char& c = cells.data()[i];
+        c = (unsigned char)((c & 0xF0) | (bits & 7));
+    }
+
+    void minesPlaced() override { addNeighborCounts(cells.data(), W, H); }
+    size_t bytes() const override { return cells.size(); }
+    MemoryPlacement::Pages pages() const { return cells.pages(); }
+};
+
+// Три битовые плоскости (3 бита на клетку); число считается по плоскости мин
+class BitPlaneBoardStorage final : public IBoardStorage {
+    int W = 0, H = 0;
+    std::vector<std::uint64_t> mine, opened, flag;
+
+    static bool bit(const std::vector<std::uint64_t>& p, size_t i) { return (p[i >> 6] >> (i & 63)) & 1; }
+    static void put(std::vector<std::uint64_t>& p, size_t i, bool v) {
+        std::uint64_t m = std::uint64_t(1) << (i & 63);
+        p[i >> 6] = v ? (p[i >> 6] | m) : (p[i >> 6] & ~m);
+    }
+public:
+    const char* name() const override { return "bits"; }
+
+    void reset(int w, int h) override {
+        W = w; H = h;
+        size_t words = ((size_t)w * h + 63) / 64;
+        mine.assign(words, 0);
+        opened.assign(words, 0);
+        flag.assign(words, 0);
+    }
+
+    unsigned char get(size_t i) const override {
+        unsigned char c = (unsigned char)(bit(mine, i) | bit(opened, i) << 1 | bit(flag, i) << 2);
+        if (c & kMine) return c;
+        int x = (int)(i % W), y = (int)(i / W), n = 0;
+        for (int ny = std::max(0, y - 1); ny <= std::min(H - 1, y + 1); ny++)
+            for (int nx = std::max(0, x - 1); nx <= std::min(W - 1, x + 1); nx++)
+                n += bit(mine, (size_t)ny * W + nx);
+        return (unsigned char)(c | n << kNumberShift);
+    }
+
+    void set(size_t i, unsigned char bits) override {
+        put(mine, i, bits & kMine);
+        put(opened, i, bits & kOpened);
+        put(flag, i, bits & kFlag);
+    }
+
+    void minesPlaced() override {}
+    size_t bytes() const override { return (mine.capacity() + opened.capacity() + flag.capacity()) * 8; }
+};
+
+// Плитки 64x64 (байт на клетку, как dense), создаются при первой записи:
+// нетронутые части огромного поля память не занимают, соседи по вертикали
+// лежат в одной плитке
+class TiledBoardStorage final : public IBoardStorage {
+    static constexpr int kTile = 64;
+    int W = 0, H = 0, tilesX = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> tiles;
+    size_t allocated = 0;
+
+    unsigned char* cell(int x, int y, bool create) {
+        std::unique_ptr<unsigned char[]>& t = tiles[(size_t)(y / kTile) * tilesX + x / kTile];
+        if (!t) {
+            if (!create) return nullptr;
+            t.reset(new unsigned char[kTile * kTile]());
+            allocated++;
+        }
+        return &t[(y % kTile) * kTile + x % kTile];
+    }
+public:
+    const char* name() const override { return "tiles"; }
+
+    void reset(int w, int h) override {
+        W = w; H = h;
+        tilesX = (w + kTile - 1) / kTile;
+        tiles.clear();
+        tiles.resize((size_t)tilesX * ((h + kTile - 1) / kTile));
+        allocated = 0;
+    }
+
+    unsigned char get(size_t i) const override {
+        int x = (int)(i % W), y = (int)(i / W);
+        const std::unique_ptr<unsigned char[]>& t = tiles[(size_t)(y / kTile) * tilesX + x / kTile];
+        return t ? t[(y % kTile) * kTile + x % kTile] : 0;
+    }
+
+    void set(size_t i, unsigned char bits) override {
+        unsigned char* c = cell((int)(i % W), (int)(i / W), bits != 0);
+        if (c) *c = (unsigned char)((*c & 0xF0) | (bits & 7));
+    }
+
+    void minesPlaced() override {
+        for (int ty = 0; ty * kTile < H; ty++)
+            for (int tx = 0; tx < tilesX; tx++) {
+                if (!tiles[(size_t)ty * tilesX + tx]) continue;
+                for (int y = ty * kTile; y < std::min(H, (ty + 1) * kTile); y++)
+                    for (int x = tx * kTile; x < std::min(W, (tx + 1) * kTile); x++) {
+                        if (!(*cell(x, y, false) & kMine)) continue;
+                        for (int ny = std::max(0, y - 1); ny <= std::min(H - 1, y + 1); ny++)
+                            for (int nx = std::max(0, x - 1); nx <= std::min(W - 1, x + 1); nx++)
+                                if (nx != x || ny != y) *cell(nx, ny, true) += 1 << kNumberShift;
+                    }
+            }
+    }
+
+    size_t bytes() const override {
+        return allocated * kTile * kTile + tiles.capacity() * sizeof(tiles[0]);
+    }
+};
+
+// Factory: хранилище по имени; nullptr — неизвестное имя
+static std::unique_ptr<IBoardStorage> makeBoardStorage(const std::string& name) {
+    if (name == "dense") return std::make_unique<DenseBoardStorage>();
+    if (name == "bits")  return std::make_unique<BitPlaneBoardStorage>();
+    if (name == "tiles") return std::make_unique<TiledBoardStorage>();
+    return nullptr;
+}
+
+// Правила партии над IBoardStorage — одни для Game и для гигантских досок.
+// Hooks — наблюдатель правил (шаблонный параметр, вызовы встраиваются, как
+// у Visitor в BoardCodec::run): opened(i, wasFlagged) — клетка открылась,
+// flagToggled(i, flagged) — флаг поставлен или снят. Game по ним ведёт объекты
+// клеток, журнал и фронтир; без Game наблюдателя нет (NoHooks).
+class PlaneBoard {
+public:
+    struct NoHooks {
+        void opened(size_t, bool) {}
+        void flagToggled(size_t, bool) {}
+    };
+
+    int    W, H, MINES;
+    bool   gameOver = false;
+    bool   win = false;
+    bool   firstClick = true;
+    size_t openedCount = 0;
+    int    flagCount = 0;
+    size_t explodedAt = 0; // взорвавшаяся мина (после проигрыша ходом)
+
+    // Состояние партии помимо клеток (для файла поля)
+    struct Counters {
+        size_t opened = 0;
+        int    flags = 0, wrongFlags = 0;
+        bool   firstClick = true, gameOver = false, win = false;
+    };
+
+    PlaneBoard(int w, int h, int mines, std::unique_ptr<IBoardStorage> s)
+        : W(w), H(h), MINES(mines), storage(std::move(s))
+    {
+        reset();
+    }
+
+    // Хранилище с уже расставленным полем (например, из файла)
+    PlaneBoard(int w, int h, int mines, std::unique_ptr<IBoardStorage> s, const Counters& c)
+        : W(w), H(h), MINES(mines), gameOver(c.gameOver), win(c.win), firstClick(c.firstClick),
+          openedCount(c.opened), flagCount(c.flags), storage(std::move(s)), wrongFlags(c.wrongFlags) {}
+
+    Counters counters() const {
+        Counters c;
+        c.opened = openedCount;
+        c.flags = flagCount;
+        c.wrongFlags = wrongFlags;
+        c.firstClick = firstClick;
+        c.gameOver = gameOver;
+        c.win = win;
+        return c;
+    }
+
+    void reseed(std::uint32_t seed) { rng.seed(seed); }
+
+    void reset() {
+        storage->reset(W, H);
+        gameOver = win = false;
+        firstClick = true;
+        openedCount = 0;
+        flagCount = wrongFlags = 0;
+        explodedAt = 0;
+    }
+
+    const IBoardStorage& cells() const { return *storage; }
+    size_t index(int x, int y) const { return (size_t)y * W + x; }
+    bool isMine(size_t i) const { return (storage->get(i) & IBoardStorage::kMine) != 0; }
+
+    // То, что видит игрок (VisibleCode)
+    unsigned char visible(int x, int y) const {
+        unsigned char c = storage->get(index(x, y));
+        if (c & IBoardStorage::kFlag) return VisFlag;
+        if (!(c & IBoardStorage::kOpened)) return VisClosed;
+        if (c & IBoardStorage::kMine) return VisMine;
+        return (unsigned char)(c >> IBoardStorage::kNumberShift);
+    }
+
+    // Расстановка извне (генераторы Game, перенос поля): мины по одной,
+    // затем minesPlaced — хранилище считает числа, первый клик позади
+    void placeMine(size_t i) {
+        unsigned char c = storage->get(i);
+        if (c & IBoardStorage::kMine) return;
+        storage->set(i, (unsigned char)(c | IBoardStorage::kMine));
+        if (c & IBoardStorage::kFlag) wrongFlags--;
+    }
+
+    void minesPlaced() {
+        storage->minesPlaced();
+        firstClick = false;
+    }
+
+    void reveal(int x, int y)     { NoHooks h; reveal(x, y, h); }
+    void toggleFlag(int x, int y) { NoHooks h; toggleFlag(x, y, h); }
+    void chord(int x, int y)      { NoHooks h; chord(x, y, h); }
+
+    // Открыть клетку; на первом клике мины расставляет сам PlaneBoard
+    // (у Game к этому времени их уже расставил генератор)
+    template <class Hooks>
+    void reveal(int x, int y, Hooks& hooks) {
+        if (gameOver || win) return;
+        size_t i = index(x, y);
+        unsigned char c = storage->get(i);
+        if (c & (IBoardStorage::kOpened | IBoardStorage::kFlag)) return;
+        if (firstClick) {
+            placeMines(x, y);
+            c = storage->get(i);
+        }
+        if (c & IBoardStorage::kMine) { explode(i, hooks); return; }
+
+        open(i, c, hooks);
+        // Проём: явный стек вместо рекурсии — на больших полях он бывает
+        // в миллионы клеток
+        stack.clear();
+        if ((c >> IBoardStorage::kNumberShift) == 0) stack.push_back(i);
+        while (!stack.empty()) {
+            size_t j = stack.back();
+            stack.pop_back();
+            int cx = (int)(j % W), cy = (int)(j / W);
+            for (int ny = std::max(0, cy - 1); ny <= std::min(H - 1, cy + 1); ny++)
+                for (int nx = std::max(0, cx - 1); nx <= std::min(W - 1, cx + 1); nx++) {
+                    size_t n = index(nx, ny);
+                    unsigned char cn = storage->get(n);
+                    if (cn & (IBoardStorage::kOpened | IBoardStorage::kFlag | IBoardStorage::kMine)) continue;
+                    open(n, cn, hooks);
+                    if ((cn >> IBoardStorage::kNumberShift) == 0) stack.push_back(n);
+                }
+        }
+        checkWin();
+    }
+
+    template <class Hooks>
+    void toggleFlag(int x, int y, Hooks& hooks) {
+        if (gameOver || win) return;
+        size_t i = index(x, y);
+        unsigned char c = storage->get(i);
+        if (c & IBoardStorage::kOpened) return;
+        flip(i, c, hooks);
+        checkWin();
+    }
+
+    // Chord: у открытого числа флагов вокруг ровно столько, сколько мин —
+    // открываем остальных закрытых соседей (ошибочный флаг приводит к проигрышу)
+    template <class Hooks>
+    void chord(int x, int y, Hooks& hooks) {
+        if (gameOver || win) return;
+        unsigned char c = storage->get(index(x, y));
+        int number = c >> IBoardStorage::kNumberShift;
+        if (!(c & IBoardStorage::kOpened) || (c & IBoardStorage::kMine) || number == 0) return;
+        int flags = 0;
+        for (int ny = std::max(0, y - 1); ny <= std::min(H - 1, y + 1); ny++)
+            for (int nx = std::max(0, x - 1); nx <= std::min(W - 1, x + 1); nx++)
+                flags += (storage->get(index(nx, ny)) & IBoardStorage::kFlag) != 0;
+        if (flags != number) return;
+        for (int ny = std::max(0, y - 1); ny <= std::min(H - 1, y + 1); ny++)
+            for (int nx = std::max(0, x - 1); nx <= std::min(W - 1, x + 1); nx++)
+                reveal(nx, ny, hooks);
+    }
+
+    // Перенос готового поля (снимок, архив) после minesPlaced: клетка
+    // открывается или получает флаг без правил; в конце — restored
+    template <class Hooks>
+    void restoreCell(size_t i, bool opened, bool flagged, Hooks& hooks) {
+        unsigned char c = storage->get(i);
+        if (opened) open(i, c, hooks);
+        else if (flagged && !(c & IBoardStorage::kFlag)) flip(i, c, hooks);
+    }
+
+    void restored(bool exploded) {
+        gameOver = exploded;
+        if (!exploded) checkWin();
+    }
+
+private:
+    std::unique_ptr<IBoardStorage> storage; // Strategy
+    std::mt19937 rng{std::random_device{}()};
+    int wrongFlags = 0;                     // флаги не на минах — победа по флагам за O(1)
+    std::vector<size_t> stack;
+
+    // Открытие снимает флаг (так бывает только при проигрыше)
+    template <class Hooks>
+    void open(size_t i, unsigned char c, Hooks& hooks) {
+        bool wasFlagged = (c & IBoardStorage::kFlag) != 0;
+        storage->set(i, (unsigned char)((c | IBoardStorage::kOpened) & ~IBoardStorage::kFlag));
+        openedCount++;
+        if (wasFlagged) {
+            flagCount--;
+            if (!(c & IBoardStorage::kMine)) wrongFlags--;
+        }
+        hooks.opened(i, wasFlagged);
+    }
+
+    template <class Hooks>
+    void flip(size_t i, unsigned char c, Hooks& hooks) {
+        bool flagged = !(c & IBoardStorage::kFlag);
+        storage->set(i, (unsigned char)(c ^ IBoardStorage::kFlag));
+        flagCount += flagged ? 1 : -1;
+        if (!(c & IBoardStorage::kMine)) wrongFlags += flagged ? 1 : -1;
+        hooks.flagToggled(i, flagged);
+    }
+
+    // Проигрыш: сначала взорвавшаяся мина, затем всё поле построчно
+    template <class Hooks>
+    void explode(size_t i, Hooks& hooks) {
+        explodedAt = i;
+        open(i, storage->get(i), hooks);
+        for (size_t j = 0, n = (size_t)W * H; j < n; j++) {
+            unsigned char c = storage->get(j);
+            if (!(c & IBoardStorage::kOpened)) open(j, c, hooks);
+        }
+        gameOver = true;
+    }
+
+    // Как DefaultBoardGenerator: при том же зерне — те же мины, что у Game
+    void placeMines(int safeX, int safeY) {
+        for (int placed = 0; placed < MINES;) {
+            int x = (int)(rng() % (unsigned)W);
+            int y = (int)(rng() % (unsigned)H);
+            size_t i = index(x, y);
+            if (isMine(i)) continue;
+            if (std::abs(x - safeX) <= 1 && std::abs(y - safeY) <= 1) continue;
+            placeMine(i);
+            placed++;
+        }
+        minesPlaced();
+    }
+
+    void checkWin() {
+        if (openedCount == (size_t)W * H - MINES || (flagCount == MINES && wrongFlags == 0)) win = true;
+    }
 };
 
 // GAME LOGIC (почти без SFML)
@@ -118,6 +936,12 @@ public:
     bool win        = false;
     bool firstClick = true;
 
+    // Правила партии — PlaneBoard над хранилищем клеток (Strategy, внедряется
+    // как cellFactory и boardGenerator). field ниже — представление для
+    // интерфейса, решателя и ботов: состояния клеток меняются по сообщениям
+    // правил (BoardHooks), а не сами по себе
+    PlaneBoard board;
+
     // небольшая анимация взрыва
     bool  explosion = false;
     float explosionTimer = 0.0f;
@@ -128,14 +952,45 @@ public:
 
     std::vector<std::vector<Cell>> field;
 
+    // Журнал изменённых клеток (индекс y*W+x), пополняется при каждой смене
+    // состояния. Потребители (решатель) держат свой курсор в журнале, а по
+    // boardEpoch понимают, что поле пересоздано и курсор надо сбросить.
+    std::vector<int> changeLog;
+    unsigned boardEpoch = 0;
+
+    // Фронтир, который ведётся по ходу игры (решателю не нужно сканировать поле):
+    // frontierClosed  — закрытые клетки без флага рядом с открытыми,
+    // frontierNumbers — открытые числа рядом с закрытыми клетками без флага.
+    CellSet frontierClosed;
+    CellSet frontierNumbers;
+    std::vector<unsigned char> openAround;    // открытых соседей у клетки
+    std::vector<unsigned char> unknownAround; // закрытых соседей без флага
+
+    int openedCount = 0; // открытых клеток
+    int flagCount   = 0; // поставленных флагов
+    int explodedCell = -1; // индекс взорвавшейся мины (после проигрыша)
+
+    // Подписчики на события партии. При замене партии (game = Game(...))
+    // подписки не переносятся — их оформляет тот, кто заменил.
+    GameEventBus events;
+
+    // Внутри apply: проверка победы и уведомления — один раз в конце пачки
+    bool batching = false;
+
+    mutable size_t peakMemory = 0; // для memoryUsage(): пик с прошлых полей
+
     // Dependency Injection: внедряем фабрики/стратегии извне
     std::unique_ptr<ICellFactory>    cellFactory;     // Abstract Factory
     std::unique_ptr<IBoardGenerator> boardGenerator;  // Strategy
 
+    // Хранилище по умолчанию — DenseBoardStorage
     Game(int w, int h, int mines,
          std::unique_ptr<ICellFactory> cf,
-         std::unique_ptr<IBoardGenerator> bg)
-        : W(w), H(h), MINES(mines), cellFactory(std::move(cf)), boardGenerator(std::move(bg))
+         std::unique_ptr<IBoardGenerator> bg,
+         std::unique_ptr<IBoardStorage> storage = nullptr)
+        : W(w), H(h), MINES(mines),
+          board(w, h, mines, storage ? std::move(storage) : std::make_unique<DenseBoardStorage>()),
+          cellFactory(std::move(cf)), boardGenerator(std::move(bg))
     {
         resetField();
     }
@@ -145,7 +1000,26 @@ public:
     static std::unique_ptr<ICellState> makeOpenedState();
     static std::unique_ptr<ICellState> makeFlaggedState();
 
+    // Наблюдатель правил (PlaneBoard Hooks): клетка представления получает
+    // новое состояние, затем обновляются журнал, счётчики и фронтир
+    struct BoardHooks {
+        Game& g;
+        void opened(size_t i, bool wasFlagged) {
+            int x = (int)(i % g.W), y = (int)(i / g.W);
+            g.field[y][x].state = makeOpenedState();
+            g.noteOpened(x, y, wasFlagged);
+        }
+        void flagToggled(size_t i, bool flagged) {
+            int x = (int)(i % g.W), y = (int)(i / g.W);
+            g.field[y][x].state = flagged ? makeFlaggedState() : makeClosedState();
+            g.noteFlagToggled(x, y);
+        }
+    };
+
     void resetField() {
+        // Пик старого поля — одной суммой, без дерева memoryUsage()
+        peakMemory = std::max(peakMemory, cellBytes() + vectorBytes(changeLog) + frontierBytes()
+                                              + board.cells().bytes());
         // Создаём поле, используя Abstract Factory
         field.clear();
         field.resize(H);
@@ -156,7 +1030,24 @@ public:
             }
         }
 
-        // Сбрасываем флаги игры
+        // Поля пересоздаются и в рабочих потоках — счётчик общий, атомарный
+        static std::atomic<unsigned> epochSeq{0};
+        boardEpoch = ++epochSeq;
+        changeLog.clear();
+
+        frontierClosed.reset(W * H);
+        frontierNumbers.reset(W * H);
+        openedCount = 0;
+        flagCount = 0;
+        explodedCell = -1;
+        openAround.assign((size_t)W * H, 0);
+        unknownAround.assign((size_t)W * H, 0);
+        for (int y = 0; y < H; ++y)
+            for (int x = 0; x < W; ++x)
+                forEachNeighbor(x, y, [&](int, int, int) { unknownAround[index(x, y)]++; });
+
+        // Сбрасываем правила и флаги игры
+        board.reset();
         gameOver = false;
         win = false;
         firstClick = true;
@@ -166,6 +1057,8 @@ public:
 
         timerRunning = false;
         timeElapsed = 0.0f;
+
+        publish(GameEventType::Reset);
     }
 
     void update(float dt) {
@@ -184,228 +1077,3888 @@ public:
 
     void stopTimer() { timerRunning = false; }
 
+    int  index(int x, int y) const { return y * W + x; }
+    void markChanged(int x, int y) { changeLog.push_back(index(x, y)); }
+
+    void publish(GameEventType type, int x = -1, int y = -1, bool flagged = false) {
+        if (!events.active() || batching) return;
+        GameEvent e;
+        e.type = type; e.x = x; e.y = y; e.flagged = flagged;
+        events.publish(*this, e);
+    }
+
+    // Открытые одним действием клетки — хвост журнала с позиции from
+    void publishOpened(size_t from, int x, int y) {
+        if (!events.active() || batching || from == changeLog.size()) return;
+        GameEvent e;
+        e.type = GameEventType::CellsOpened; e.x = x; e.y = y;
+        e.cells = changeLog.data() + from;
+        e.count = changeLog.size() - from;
+        events.publish(*this, e);
+    }
+
+    // Клетки — строки field плюс по два объекта в куче (содержимое и состояние),
+    // у правил — хранилище (dense: байт на клетку); журнал изменений и фронтир растут с партией и не сжимаются до resetField
+    // Дерево строится только по запросу (F3, --memory-limit, JSON)
+    MemoryUsage memoryUsage() const {
+        MemoryUsage u("game", 0);
+        u.add(MemoryUsage("cells", cellBytes()));
+        u.add(MemoryUsage("change log", vectorBytes(changeLog)));
+        u.add(MemoryUsage("frontier", frontierBytes()));
+        u.add(MemoryUsage("rules", board.cells().bytes()));
+        return u.track(peakMemory);
+    }
+
+    size_t cellBytes() const {
+        size_t cells = vectorBytes(field);
+        for (const std::vector<Cell>& row : field) cells += vectorBytes(row);
+        return cells + (size_t)W * H * (heapBlockBytes(sizeof(NumberContent)) + heapBlockBytes(sizeof(ICellState)));
+    }
+
+    size_t frontierBytes() const {
+        return frontierClosed.bytes() + frontierNumbers.bytes() + vectorBytes(openAround) + vectorBytes(unknownAround);
+    }
+
+    template <class F>
+    void forEachNeighbor(int x, int y, F f) const {
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dx == 0 && dy == 0) continue;
+                int nx = x + dx, ny = y + dy;
+                if (nx >= 0 && nx < W && ny >= 0 && ny < H) f(nx, ny, index(nx, ny));
+            }
+    }
+
+    bool isFrontierNumber(int x, int y) const {
+        const Cell& c = field[y][x];
+        return c.state->isOpen() && !c.content->isMine() && c.content->number() > 0
+            && unknownAround[index(x, y)] > 0;
+    }
+
+    // Клетка только что открылась (флаг с неё снимается только при взрыве)
+    void noteOpened(int x, int y, bool wasFlagged = false) {
+        markChanged(x, y);
+        int i = index(x, y);
+        openedCount++;
+        if (wasFlagged) flagCount--;
+        frontierClosed.erase(i);
+        forEachNeighbor(x, y, [&](int nx, int ny, int n) {
+            openAround[n]++;
+            if (!wasFlagged) unknownAround[n]--;
+            const ICellState& s = *field[ny][nx].state;
+            if (!s.isOpen() && !s.isFlagged()) frontierClosed.insert(n);
+            else if (s.isOpen() && unknownAround[n] == 0) frontierNumbers.erase(n);
+        });
+        if (isFrontierNumber(x, y)) frontierNumbers.insert(i);
+    }
+
+    // На клетке поставили или сняли флаг
+    void noteFlagToggled(int x, int y) {
+        markChanged(x, y);
+        int i = index(x, y);
+        bool flagged = field[y][x].state->isFlagged();
+        flagCount += flagged ? 1 : -1;
+        if (flagged) frontierClosed.erase(i);
+        else if (openAround[i] > 0) frontierClosed.insert(i);
+        forEachNeighbor(x, y, [&](int nx, int ny, int n) {
+            unknownAround[n] += flagged ? -1 : 1;
+            if (isFrontierNumber(nx, ny)) frontierNumbers.insert(n);
+            else frontierNumbers.erase(n);
+        });
+    }
+
     // Ввод делегируется состоянию (State pattern)
     void leftClickCell(int x, int y)  { field[y][x].state->onLeftClick(*this, x, y); }
     void rightClickCell(int x, int y) { field[y][x].state->onRightClick(*this, x, y); }
 
-    // Подсчёт мин вокруг (используется генератором)
+    // Chord — по правилам PlaneBoard; открытое — одним событием
+    void chordCell(int x, int y) {
+        if (gameOver || win) return;
+        size_t from = changeLog.size();
+        BoardHooks hooks{*this};
+        board.chord(x, y, hooks);
+        afterReveal(from, x, y);
+    }
+
+    // Пачка действий: до первого проигрыша, результат каждого — в results
+    // (если не nullptr, n элементов). Победу правила видят сразу (счётчики,
+    // O(1)); подписчики получают одно CellsChanged на всю пачку, затем Won/Lost.
+    BatchResult apply(const GameAction* actions, size_t n, ActionResult* results = nullptr) {
+        BatchResult r;
+        size_t from = changeLog.size();
+        bool wasOver = gameOver || win;
+        batching = true;
+        for (size_t i = 0; i < n; i++) {
+            const GameAction& a = actions[i];
+            ActionResult res = ActionResult::Ignored;
+            if (r.lost) {
+                res = ActionResult::NotRun;
+            } else {
+                size_t before = changeLog.size();
+                if (a.x >= 0 && a.x < W && a.y >= 0 && a.y < H) {
+                    if (a.kind == GameAction::Reveal)    leftClickCell(a.x, a.y);
+                    else if (a.kind == GameAction::Flag) rightClickCell(a.x, a.y);
+                    else                                 chordCell(a.x, a.y);
+                }
+                if (gameOver && !wasOver) { res = ActionResult::Lost; r.lost = true; }
+                else if (changeLog.size() != before) res = ActionResult::Applied;
+                if (res != ActionResult::Ignored) r.applied++;
+            }
+            if (results) results[i] = res;
+        }
+        batching = false;
+
+        if (events.active() && changeLog.size() != from) {
+            GameEvent e;
+            e.type = GameEventType::CellsChanged;
+            e.cells = changeLog.data() + from;
+            e.count = changeLog.size() - from;
+            events.publish(*this, e);
+        }
+        r.won = win && !wasOver;
+        if (r.won) publish(GameEventType::Won);
+        // Chord взрывается на соседе, а не на своей клетке
+        if (r.lost) publish(GameEventType::Lost, explodedCell % W, explodedCell / W);
+        return r;
+    }
+
+    BatchResult apply(const std::vector<GameAction>& actions, ActionResult* results = nullptr) {
+        return apply(actions.data(), actions.size(), results);
+    }
+
+    // Для генераторов (Strategy): мины ставятся в хранилище правил; числа
+    // и содержимое клеток — minesPlaced
+    bool isMine(int x, int y) const { return board.isMine((size_t)index(x, y)); }
+    void placeMine(int x, int y) { board.placeMine((size_t)index(x, y)); }
+
+    // Мины расставлены: хранилище считает числа, содержимое клеток
+    // представления строится по нему (Abstract Factory)
+    void minesPlaced() {
+        board.minesPlaced();
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++) {
+                unsigned char c = board.cells().get((size_t)index(x, y));
+                field[y][x].content = (c & IBoardStorage::kMine)
+                    ? cellFactory->makeMineContent()
+                    : cellFactory->makeNumberContent(c >> IBoardStorage::kNumberShift);
+            }
+    }
+
+    // Подсчёт мин вокруг — по хранилищу правил
     int countMinesAround(int x, int y) const {
         int cnt = 0;
-        for (int dy = -1; dy <= 1; dy++)
-            for (int dx = -1; dx <= 1; dx++)
-                if (!(dx == 0 && dy == 0)) {
-                    int nx = x + dx, ny = y + dy;
-                    if (nx >= 0 && nx < W && ny >= 0 && ny < H)
-                        if (field[ny][nx].content && field[ny][nx].content->isMine())
-                            cnt++;
-                }
+        forEachNeighbor(x, y, [&](int, int, int n) { cnt += board.isMine((size_t)n); });
         return cnt;
     }
 
     void revealFromState(int x, int y) {// открыть клетку (из State)
         if (gameOver || win) return;
 
-        Cell &c = field[y][x];
-
         // нельзя открыть открытую/флажок
+        const Cell &c = field[y][x];
         if (c.state->isOpen() || c.state->isFlagged()) return;
 
         // 1-й клик: генерация поля (Strategy)
         if (firstClick) {
             boardGenerator->generate(*this, x, y); // Strategy usage
+            minesPlaced();
             firstClick = false;
             startTimerIfNeeded();
         }
 
-        // Открываем клетку (State switching)
-        c.state = makeOpenedState();
-
-        // Если мина — проигрыш
-        if (c.content->isMine()) {
-            triggerExplosion();
-            return;
-        }
-
-        // Если пусто — flood fill (раскрытие области)
-        if (c.content->isEmpty()) {
-            floodFill(x, y);
-        }
-
-        checkWin();
+        // Открытие и проём — по правилам PlaneBoard, весь проём одним событием
+        size_t from = changeLog.size();
+        BoardHooks hooks{*this};
+        board.reveal(x, y, hooks);
+        afterReveal(from, x, y);
     }
 
     void toggleFlagFromState(int x, int y) {// поставить/снять флаг(из State)
         if (gameOver || win) return;
 
-        Cell &c = field[y][x];
-
         // на открытой клетке флаг не ставим
-        if (c.state->isOpen()) return;
+        if (field[y][x].state->isOpen()) return;
 
-        // State switching: Closed <-> Flagged
-        if (c.state->isFlagged()) c.state = makeClosedState();
-        else c.state = makeFlaggedState();
+        // State switching: Closed <-> Flagged (через BoardHooks)
+        BoardHooks hooks{*this};
+        board.toggleFlag(x, y, hooks);
+        publish(GameEventType::FlagChanged, x, y, field[y][x].state->isFlagged());
 
         checkWin();
     }
 
-    void floodFill(int x, int y) {
-        // Рекурсивно открываем соседей у нулевых клеток
-        for (int dy = -1; dy <= 1; dy++)
-            for (int dx = -1; dx <= 1; dx++)
-                if (!(dx == 0 && dy == 0)) {
-                    int nx = x + dx, ny = y + dy;
-                    if (nx >= 0 && nx < W && ny >= 0 && ny < H) {
-                        Cell &c = field[ny][nx];
-
-                        // не открываем мины, флаги и уже открытое
-                        if (!c.state->isOpen() && !c.state->isFlagged() && !c.content->isMine()) {
-                            c.state = makeOpenedState();
-                            if (c.content->isEmpty()) floodFill(nx, ny);
-                        }
-                    }
-                }
+    void unflagFromState(int x, int y) {// снять флаг (из State)
+        toggleFlagFromState(x, y);
+    }
+
+    // Перенос готового поля (снимок, архив): мины — placeMine и minesPlaced,
+    // затем клетки restoreCell, в конце restored; ходов при этом нет
+    void restoreCell(int x, int y, bool opened, bool flagged) {
+        BoardHooks hooks{*this};
+        board.restoreCell((size_t)index(x, y), opened, flagged, hooks);
+    }
+
+    void restored(bool exploded) {
+        board.restored(exploded);
+        firstClick = false;
+        gameOver = exploded;
+        checkWin();
+        timerRunning = !gameOver && !win;
     }
 
-    void triggerExplosion() {
-        // логика проигрыша
-        explosion = true;
-        explosionTimer = 0.2f;
+    int flagsCount() const { return flagCount; }
+
+    // Победу определяют правила (счётчики, O(1)) — здесь таймер и событие
+    void checkWin() {
+        if (win || !board.win) return;
+        win = true;
+        stopTimer();
+        publish(GameEventType::Won); // в пачке — один раз в конце apply
+    }
 
-        // раскрываем всё поле
-        for (int yy = 0; yy < H; yy++)
-            for (int xx = 0; xx < W; xx++)
-                field[yy][xx].state = makeOpenedState();
+private:
+    // После хода правил: проигрыш (анимация, таймер, Lost) или проверка победы
+    void afterReveal(size_t from, int x, int y) {
+        if (board.gameOver && !gameOver) {
+            gameOver = true;
+            explodedCell = (int)board.explodedAt;
+            explosion = true;
+            explosionTimer = 0.2f;
+            stopTimer();
+            publishOpened(from, x, y);
+            publish(GameEventType::Lost, explodedCell % W, explodedCell / W);
+            return;
+        }
+        publishOpened(from, x, y);
+        checkWin();
+    }
+};
+
+// BOARD PLANES — поле как набор плоскостей, по байту (0/1) на клетку
+
+struct BoardPlanes {
+    int W = 0, H = 0;
+    std::vector<unsigned char> mine, opened, flag;
+
+    void resize(int w, int h) {
+        W = w; H = h;
+        mine.assign((size_t)w * h, 0);
+        opened.assign((size_t)w * h, 0);
+        flag.assign((size_t)w * h, 0);
+    }
+
+    int mineCount() const { return (int)std::count(mine.begin(), mine.end(), (unsigned char)1); }
+
+    static BoardPlanes capture(const Game& g) {
+        BoardPlanes b;
+        b.resize(g.W, g.H);
+        for (int y = 0; y < g.H; y++)
+            for (int x = 0; x < g.W; x++) {
+                const Cell& c = g.field[y][x];
+                size_t i = (size_t)g.index(x, y);
+                b.mine[i]   = c.content->isMine() ? 1 : 0;
+                b.opened[i] = c.state->isOpen() ? 1 : 0;
+                b.flag[i]   = c.state->isFlagged() ? 1 : 0;
+            }
+        return b;
+    }
+};
+
+// Перенос плоскостей в игру того же размера: мины — в хранилище правил,
+// состояния клеток — через restoreCell (представление, счётчики и фронтир
+// остаются согласованными). Генератор больше не вызывается.
+static void restorePlanes(Game& game, const BoardPlanes& b) {
+    game.resetField();
+    for (int y = 0; y < game.H; y++)
+        for (int x = 0; x < game.W; x++)
+            if (b.mine[(size_t)game.index(x, y)]) game.placeMine(x, y);
+    game.minesPlaced();
+
+    bool exploded = false;
+    for (int y = 0; y < game.H; y++)
+        for (int x = 0; x < game.W; x++) {
+            size_t i = (size_t)game.index(x, y);
+            if (b.opened[i] || b.flag[i]) game.restoreCell(x, y, b.opened[i], b.flag[i]);
+            exploded = exploded || (b.opened[i] && b.mine[i]);
+        }
+    game.restored(exploded);
+}
+
+// Сумма по окну 3x3 (вместе с самой клеткой) для плоскости из 0/1:
+// сначала суммы столбцов по трём строкам, затем по трём столбцам.
+// SSE2 — по 16 клеток; за краями поля нулевая строка и нулевые столбцы.
+static void boxSum3x3(const unsigned char* plane, int W, int H,
+                      std::vector<unsigned char>& out, std::vector<unsigned char>& col) {
+    out.resize((size_t)W * H);
+    col.assign(2 * (size_t)W + 2, 0);
+    unsigned char* c = col.data() + 1;          // суммы столбцов, c[-1] = c[W] = 0
+    const unsigned char* none = c + W + 1;      // нулевая строка
+    for (int y = 0; y < H; y++) {
+        const unsigned char* mid = plane + (size_t)y * W;
+        const unsigned char* up = y > 0 ? mid - W : none;
+        const unsigned char* down = y + 1 < H ? mid + W : none;
+        unsigned char* o = out.data() + (size_t)y * W;
+        int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        for (; x + 16 <= W; x += 16) {
+            __m128i v = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(mid + x)),
+                                     _mm_loadu_si128((const __m128i*)(up + x)));
+            v = _mm_add_epi8(v, _mm_loadu_si128((const __m128i*)(down + x)));
+            _mm_storeu_si128((__m128i*)(c + x), v);
+        }
+#endif
+        for (; x < W; x++) c[x] = (unsigned char)(mid[x] + up[x] + down[x]);
+
+        x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        for (; x + 16 <= W; x += 16) {
+            __m128i v = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(c + x - 1)),
+                                     _mm_loadu_si128((const __m128i*)(c + x)));
+            v = _mm_add_epi8(v, _mm_loadu_si128((const __m128i*)(c + x + 1)));
+            _mm_storeu_si128((__m128i*)(o + x), v);
+        }
+#endif
+        for (; x < W; x++) o[x] = (unsigned char)(c[x - 1] + c[x] + c[x + 1]);
+    }
+}
+
+// BOARD VERIFIER — проверка поля, пришедшего извне (файл, снимок, архив):
+//   значения плоскостей — только 0/1, открытая клетка не под флагом;
+//   числа совпадают с пересчётом по плоскости мин;
+//   открытая мина (проигрыш) — значит, открыто всё поле;
+//   у открытого нуля нет закрытых соседей без флага (так работает flood fill);
+//   для Game — ещё и счётчики openedCount/flagCount.
+// Основные проходы — SSE2 по 16 клеток; блок с нарушением разбирается
+// поштучно, в отчёт попадают первые maxReport нарушений.
+// Байтовые клетки PlaneBoard (файл поля) проверяются теми же правилами
+// построчно, без плоскостей, вместе со счётчиками партии.
+
+class BoardVerifier {
+public:
+    struct Issue {
+        int x = 0, y = 0;
+        const char* what = "";
+    };
+
+    struct Report {
+        size_t issues = 0;
+        std::vector<Issue> first;
+        bool ok() const { return issues == 0; }
+
+        std::string describe() const {
+            if (ok()) return "ok";
+            std::string s = std::to_string(issues) + " issue(s):";
+            for (const Issue& i : first)
+                s += " (" + std::to_string(i.x) + "," + std::to_string(i.y) + ") " + i.what + ";";
+            return s;
+        }
+    };
+
+    explicit BoardVerifier(size_t maxReport = 8) : maxReport(maxReport) {}
+
+    // numbers — сохранённые числа (у мин не смотрятся); nullptr — не проверять
+    Report verify(const BoardPlanes& b, const unsigned char* numbers = nullptr) {
+        Report r;
+        const int W = b.W;
+        const size_t cells = (size_t)b.W * b.H;
+        if (b.mine.size() != cells || b.opened.size() != cells || b.flag.size() != cells) {
+            add(r, 0, 0, "plane size");
+            return r;
+        }
+        const unsigned char* mine = b.mine.data();
+        const unsigned char* opened = b.opened.data();
+        const unsigned char* flag = b.flag.data();
+
+        // Допустимые значения, открытое под флагом, числа
+        boxSum3x3(mine, b.W, b.H, box, col);
+        openZero.resize(cells);
+        bool exploded = false;
+        size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i one = _mm_set1_epi8(1), zero = _mm_setzero_si128();
+        __m128i anyOpenMine = zero;
+        for (; i + 16 <= cells; i += 16) {
+            __m128i m = _mm_loadu_si128((const __m128i*)(mine + i));
+            __m128i o = _mm_loadu_si128((const __m128i*)(opened + i));
+            __m128i f = _mm_loadu_si128((const __m128i*)(flag + i));
+            __m128i sum = _mm_loadu_si128((const __m128i*)(box.data() + i));
+            // значения 0/1: max(m, o, f) <= 1; открытое и флаг — не одновременно
+            __m128i valid = _mm_cmpeq_epi8(_mm_max_epu8(_mm_max_epu8(_mm_max_epu8(m, o), f), one), one);
+            __m128i bad = _mm_or_si128(_mm_cmpeq_epi8(valid, zero), _mm_cmpeq_epi8(_mm_and_si128(o, f), one));
+            if (numbers) {
+                __m128i expect = _mm_sub_epi8(sum, m);
+                __m128i same = _mm_cmpeq_epi8(expect, _mm_loadu_si128((const __m128i*)(numbers + i)));
+                __m128i isMine = _mm_cmpeq_epi8(m, one);
+                bad = _mm_or_si128(bad, _mm_cmpeq_epi8(_mm_or_si128(same, isMine), zero));
+            }
+            anyOpenMine = _mm_or_si128(anyOpenMine, _mm_and_si128(m, o));
+            _mm_storeu_si128((__m128i*)(openZero.data() + i),
+                             _mm_and_si128(o, _mm_and_si128(_mm_cmpeq_epi8(sum, zero), one)));
+            if (_mm_movemask_epi8(bad))
+                for (size_t k = i; k < i + 16; k++) checkCell(r, b, numbers, k);
+        }
+        exploded = _mm_movemask_epi8(_mm_cmpeq_epi8(anyOpenMine, zero)) != 0xFFFF;
+#endif
+        for (; i < cells; i++) {
+            checkCell(r, b, numbers, i);
+            exploded = exploded || (mine[i] && opened[i]);
+            openZero[i] = (unsigned char)(opened[i] & (box[i] == 0));
+        }
+
+        if (exploded) {
+            // Проигрыш раскрывает всё поле
+            for (size_t k = 0; k < cells; k++)
+                if (!opened[k]) add(r, (int)(k % W), (int)(k / W), "closed cell after explosion");
+            return r;
+        }
+
+        // Flood fill: соседи открытого нуля открыты (или под флагом)
+        boxSum3x3(openZero.data(), b.W, b.H, box, col);
+        i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        for (; i + 16 <= cells; i += 16) {
+            __m128i nearZero = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(box.data() + i)), zero);
+            __m128i covered = _mm_or_si128(_mm_loadu_si128((const __m128i*)(opened + i)),
+                                           _mm_loadu_si128((const __m128i*)(flag + i)));
+            __m128i bad = _mm_andnot_si128(nearZero, _mm_cmpeq_epi8(covered, zero));
+            if (_mm_movemask_epi8(bad))
+                for (size_t k = i; k < i + 16; k++)
+                    if (box[k] && !opened[k] && !flag[k]) add(r, (int)(k % W), (int)(k / W), "closed next to open zero");
+        }
+#endif
+        for (; i < cells; i++)
+            if (box[i] && !opened[i] && !flag[i]) add(r, (int)(i % W), (int)(i / W), "closed next to open zero");
+        return r;
+    }
+
+    // Игра: плоскости и числа из клеток плюс согласованность счётчиков
+    Report verify(const Game& g) {
+        BoardPlanes b = BoardPlanes::capture(g);
+        numbers.resize(b.mine.size());
+        for (int y = 0; y < g.H; y++)
+            for (int x = 0; x < g.W; x++)
+                numbers[(size_t)g.index(x, y)] = (unsigned char)g.field[y][x].content->number();
+        Report r = verify(b, numbers.data());
+        int opened = (int)std::count(b.opened.begin(), b.opened.end(), (unsigned char)1);
+        int flags = (int)std::count(b.flag.begin(), b.flag.end(), (unsigned char)1);
+        if (opened != g.openedCount) add(r, 0, 0, "openedCount");
+        if (flags != g.flagCount) add(r, 0, 0, "flagCount");
+        if (!g.firstClick && b.mineCount() != g.MINES) add(r, 0, 0, "mine count");
+        return r;
+    }
+
+    // Клетки PlaneBoard байт на клетку (файл поля, DenseBoardStorage) после
+    // первого клика. Память — O(W): суммы мин по столбцам окна из трёх строк.
+    // Строка проходится без ветвлений; строка с нарушением или открытым нулём
+    // (проверка проёма) разбирается поштучно. Счётчики c, MINES и win/gameOver
+    // сверяются с тем, что насчитано
+    Report verify(const unsigned char* cells, int W, int H, int mines, const PlaneBoard::Counters& c) {
+        Report r;
+        const size_t area = (size_t)W * H;
+        size_t opened = 0, mineCount = 0;
+        std::int64_t flags = 0, wrong = 0;
+        bool exploded = false;
+        col.assign((size_t)W + 2, 0); // col[x + 1] — мины столбца x в строках y-1..y+1
+        auto slide = [&](int y, int sign) {
+            const unsigned char* row = cells + (size_t)y * W;
+            for (int x = 0; x < W; x++) col[(size_t)x + 1] += (unsigned char)(sign * (row[x] & IBoardStorage::kMine));
+        };
+        slide(0, 1);
+        for (int y = 0; y < H; y++) {
+            if (y + 1 < H) slide(y + 1, 1);
+            if (y >= 2) slide(y - 2, -1);
+            const unsigned char* row = cells + (size_t)y * W;
+            const unsigned char* sum = col.data();
+            unsigned bad = 0, zeros = 0, rowMines = 0, rowOpened = 0, rowFlags = 0, rowWrong = 0, rowExploded = 0;
+            int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+            const __m128i one = _mm_set1_epi8(1), zero = _mm_setzero_si128();
+            const __m128i low = _mm_set1_epi8(0x0F), spare = _mm_set1_epi8(8);
+            // Суммы байтов — через SAD с нулём, по две 64-битных половины
+            __m128i badV = zero, zerosV = zero, minesV = zero, openedV = zero, flagsV = zero, wrongV = zero;
+            for (; x + 16 <= W; x += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+                __m128i m = _mm_and_si128(v, one);
+                __m128i o = _mm_and_si128(_mm_srli_epi16(v, 1), one);
+                __m128i f = _mm_and_si128(_mm_srli_epi16(v, 2), one);
+                __m128i num = _mm_and_si128(_mm_srli_epi16(v, IBoardStorage::kNumberShift), low);
+                __m128i around = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(sum + x)),
+                                              _mm_loadu_si128((const __m128i*)(sum + x + 1)));
+                around = _mm_sub_epi8(_mm_add_epi8(around, _mm_loadu_si128((const __m128i*)(sum + x + 2))), m);
+                __m128i notMine = _mm_xor_si128(m, one);
+                __m128i wrongNumber = _mm_andnot_si128(_mm_cmpeq_epi8(num, around), notMine);
+                badV = _mm_or_si128(badV, _mm_or_si128(_mm_and_si128(v, spare), _mm_or_si128(_mm_and_si128(o, f), wrongNumber)));
+                zerosV = _mm_or_si128(zerosV, _mm_and_si128(_mm_and_si128(o, notMine), _mm_cmpeq_epi8(around, zero)));
+                rowExploded |= (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(m, o), one));
+                minesV = _mm_add_epi64(minesV, _mm_sad_epu8(m, zero));
+                openedV = _mm_add_epi64(openedV, _mm_sad_epu8(o, zero));
+                flagsV = _mm_add_epi64(flagsV, _mm_sad_epu8(f, zero));
+                wrongV = _mm_add_epi64(wrongV, _mm_sad_epu8(_mm_and_si128(f, notMine), zero));
+            }
+            auto total = [](__m128i t) { return (unsigned)(_mm_cvtsi128_si32(t) + _mm_cvtsi128_si32(_mm_srli_si128(t, 8))); };
+            bad |= (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(badV, zero)) != 0xFFFF;
+            zeros |= (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(zerosV, zero)) != 0xFFFF;
+            rowMines += total(minesV);
+            rowOpened += total(openedV);
+            rowFlags += total(flagsV);
+            rowWrong += total(wrongV);
+#endif
+            for (; x < W; x++) {
+                unsigned v = row[x], m = v & 1, o = (v >> 1) & 1, f = (v >> 2) & 1;
+                unsigned around = (unsigned)sum[x] + sum[x + 1] + sum[x + 2] - m;
+                bad |= (v & 8) | (o & f) | ((m ^ 1) & ((v >> IBoardStorage::kNumberShift) != around));
+                zeros |= o & (m ^ 1) & (around == 0);
+                rowMines += m;
+                rowOpened += o;
+                rowFlags += f;
+                rowWrong += f & (m ^ 1);
+                rowExploded |= m & o;
+            }
+            mineCount += rowMines;
+            opened += rowOpened;
+            flags += rowFlags;
+            wrong += rowWrong;
+            exploded = exploded || rowExploded;
+            if (bad)
+                for (int x = 0; x < W; x++) {
+                    unsigned char v = row[x];
+                    int around = sum[x] + sum[x + 1] + sum[x + 2] - (v & IBoardStorage::kMine);
+                    if (v & 8) add(r, x, y, "unknown cell bits");
+                    else if ((v & IBoardStorage::kOpened) && (v & IBoardStorage::kFlag)) add(r, x, y, "flag on opened cell");
+                    else if (!(v & IBoardStorage::kMine) && (v >> IBoardStorage::kNumberShift) != around)
+                        add(r, x, y, "number mismatch");
+                }
+            // Flood fill: соседи открытого нуля открыты (или под флагом)
+            if (zeros && !c.gameOver)
+                for (int x = 0; x < W; x++) {
+                    unsigned char v = row[x];
+                    if ((v & (IBoardStorage::kOpened | IBoardStorage::kMine)) != IBoardStorage::kOpened
+                        || sum[x] + sum[x + 1] + sum[x + 2] != 0) continue;
+                    for (int ny = std::max(0, y - 1); ny <= std::min(H - 1, y + 1); ny++)
+                        for (int nx = std::max(0, x - 1); nx <= std::min(W - 1, x + 1); nx++)
+                            if (!(cells[(size_t)ny * W + nx] & (IBoardStorage::kOpened | IBoardStorage::kFlag)))
+                                add(r, nx, ny, "closed next to open zero");
+                }
+        }
+
+        if (opened != c.opened) add(r, 0, 0, "openedCount");
+        if (flags != c.flags) add(r, 0, 0, "flagCount");
+        if (wrong != c.wrongFlags) add(r, 0, 0, "wrongFlags");
+        if (mineCount != (size_t)mines) add(r, 0, 0, "mine count");
+        // Проигрыш раскрывает всё поле; победа — по тем же условиям, что у правил
+        if (exploded != c.gameOver) add(r, 0, 0, "gameOver");
+        if (exploded && opened != area) add(r, 0, 0, "closed cell after explosion");
+        bool won = !exploded && (opened == area - mineCount || (flags == mines && wrong == 0));
+        if (won != c.win) add(r, 0, 0, "win");
+        return r;
+    }
+
+private:
+    size_t maxReport;
+    std::vector<unsigned char> box, col, openZero, numbers;
+
+    void add(Report& r, int x, int y, const char* what) const {
+        r.issues++;
+        if (r.first.size() < maxReport) r.first.push_back({x, y, what});
+    }
+
+    void checkCell(Report& r, const BoardPlanes& b, const unsigned char* nums, size_t i) const {
+        int x = (int)(i % b.W), y = (int)(i / b.W);
+        if (b.mine[i] > 1 || b.opened[i] > 1 || b.flag[i] > 1) add(r, x, y, "plane value not 0/1");
+        else if (b.opened[i] && b.flag[i]) add(r, x, y, "flag on opened cell");
+        else if (nums && !b.mine[i] && nums[i] != (unsigned char)(box[i] - b.mine[i])) add(r, x, y, "number mismatch");
+    }
+};
+
+// MAPPED FILE — файл целиком в памяти:
+// на POSIX — mmap (страницы подгружаются по мере чтения), на Windows — чтение.
+// CopyOnWrite — страницы можно менять, изменения остаются в памяти процесса
+// (MAP_PRIVATE), файл на диске не меняется.
+
+class MappedFile {
+public:
+    enum class Access { ReadOnly, CopyOnWrite };
+
+private:
+    unsigned char* ptr = nullptr;
+    size_t len = 0;
+    bool writable = false;
+#if defined(_WIN32)
+    std::vector<unsigned char> buffer;
+#else
+    void* map = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path, Access access = Access::ReadOnly) {
+        close();
+        writable = access == Access::CopyOnWrite;
+#if defined(_WIN32)
+        std::ifstream f(path, std::ios::binary);
+        if (!f) return false;
+        buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        ptr = buffer.data();
+        len = buffer.size();
+        return true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        len = ok ? (size_t)st.st_size : 0;
+        if (ok && len > 0) {
+            map = mmap(nullptr, len, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = map != MAP_FAILED;
+            if (ok) {
+                // разбор читает подряд, игра на поле — вразброс
+                madvise(map, len, writable ? MADV_RANDOM : MADV_SEQUENTIAL);
+                ptr = (unsigned char*)map;
+            } else {
+                map = nullptr;
+                len = 0;
+            }
+        }
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    void close() {
+#if defined(_WIN32)
+        buffer.clear();
+#else
+        if (map) munmap(map, len);
+        map = nullptr;
+#endif
+        ptr = nullptr;
+        len = 0;
+        writable = false;
+    }
+
+    const unsigned char* data() const { return ptr; }
+    unsigned char* writableData() { return writable ? ptr : nullptr; }
+    size_t size() const { return len; }
+
+    // Сколько страниц файла уже в памяти (страничный кэш; на Linux — mincore,
+    // иначе весь размер)
+    size_t residentBytes() const {
+#if defined(__linux__)
+        if (!map) return 0;
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        std::vector<unsigned char> vec((len + page - 1) / page);
+        if (mincore(map, len, vec.data()) != 0) return len;
+        size_t pages = 0;
+        for (unsigned char v : vec) pages += v & 1;
+        return std::min(len, pages * page);
+#else
+        return len;
+#endif
+    }
+};
+
+// MINE MAP — фиксированная расстановка мин из файла:
+//   текст  — строки из '*' (мина) и '.' одинаковой длины (\n или \r\n);
+//   бинарь — "MSMB", W, H (uint32), затем W*H бит по строкам (младший бит первый).
+
+// Строка текста в плоскость мин; -1 — все символы допустимы, иначе позиция ошибки.
+// SSE2: 16 символов за раз — сравнение с '*' и '.', movemask проверяет алфавит,
+// маска '*' сразу становится байтами 0/1 плоскости.
+static int parseMineRow(const unsigned char* row, int w, unsigned char* out) {
+    int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i star = _mm_set1_epi8('*'), dot = _mm_set1_epi8('.'), one = _mm_set1_epi8(1);
+    for (; x + 16 <= w; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+        __m128i isStar = _mm_cmpeq_epi8(v, star);
+        int valid = _mm_movemask_epi8(_mm_or_si128(isStar, _mm_cmpeq_epi8(v, dot)));
+        if (valid != 0xFFFF) break; // позицию ошибки найдёт скалярный хвост
+        _mm_storeu_si128((__m128i*)(out + x), _mm_and_si128(isStar, one));
+    }
+#endif
+    for (; x < w; x++) {
+        if (row[x] != '*' && row[x] != '.') return x;
+        out[x] = row[x] == '*';
+    }
+    return -1;
+}
+
+static bool parseMineText(const unsigned char* p, size_t n, BoardPlanes& b, std::string& err) {
+    // Границы строк (memchr в libc векторизован); пустые строки в конце допустимы
+    std::vector<std::pair<size_t, int>> rows;
+    int w = -1;
+    for (size_t pos = 0; pos < n;) {
+        const void* nl = std::memchr(p + pos, '\n', n - pos);
+        size_t e = nl ? (size_t)((const unsigned char*)nl - p) : n;
+        size_t len = e - pos;
+        if (len > 0 && p[e - 1] == '\r') len--;
+        if (len > 0) {
+            if (w < 0) w = (int)std::min<size_t>(len, (size_t)1 << 30);
+            if ((int)len != w) {
+                err = "row " + std::to_string(rows.size() + 1) + ": width " + std::to_string(len)
+                    + ", expected " + std::to_string(w);
+                return false;
+            }
+            rows.push_back({pos, (int)len});
+        } else if (!rows.empty() && e < n) {
+            // пустая строка посреди поля допустима только в хвосте файла
+            size_t rest = e + 1;
+            while (rest < n && (p[rest] == '\n' || p[rest] == '\r')) rest++;
+            if (rest < n) { err = "empty row " + std::to_string(rows.size() + 1); return false; }
+        }
+        pos = e + 1;
+    }
+    if (rows.empty()) { err = "empty board"; return false; }
+    if ((std::uint64_t)w * rows.size() > 0x7FFFFFFFu) { err = "board too large"; return false; } // Game::index — int
+
+    b.resize(w, (int)rows.size());
+    for (size_t y = 0; y < rows.size(); y++) {
+        int bad = parseMineRow(p + rows[y].first, w, b.mine.data() + y * (size_t)w);
+        if (bad >= 0) {
+            err = "row " + std::to_string(y + 1) + ", column " + std::to_string(bad + 1)
+                + ": unexpected '" + std::string(1, (char)p[rows[y].first + bad]) + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseMineBinary(const unsigned char* p, size_t n, BoardPlanes& b, std::string& err) {
+    std::uint32_t w = 0, h = 0;
+    if (n < 12) { err = "truncated header"; return false; }
+    std::memcpy(&w, p + 4, 4);
+    std::memcpy(&h, p + 8, 4);
+    if (w == 0 || h == 0 || w > 65536 || h > 65536 || (std::uint64_t)w * h > 0x7FFFFFFFu) {
+        err = "bad size"; return false; // Game::index — int
+    }
+    size_t cells = (size_t)w * h;
+    if (n - 12 < (cells + 7) / 8) { err = "truncated bit plane"; return false; }
+    b.resize((int)w, (int)h);
+    const unsigned char* bits = p + 12;
+    for (size_t i = 0; i < cells; i++) b.mine[i] = (bits[i / 8] >> (i % 8)) & 1;
+    return true;
+}
+
+static bool loadMineMap(const std::string& path, BoardPlanes& b, std::string& err) {
+    MappedFile f;
+    if (!f.open(path)) { err = "cannot open " + path; return false; }
+    if (f.size() >= 4 && std::memcmp(f.data(), "MSMB", 4) == 0)
+        return parseMineBinary(f.data(), f.size(), b, err);
+    return parseMineText(f.data(), f.size(), b, err);
+}
+
+// Board generator implementation (Strategy concrete)
+
+class DefaultBoardGenerator final : public IBoardGenerator {
+    std::mt19937 rng{std::random_device{}()};
+public:
+    void reseed(std::uint32_t seed) override { rng.seed(seed); }
+
+    void generate(Game& game, int safeX, int safeY) override {
+        // поставить мины (не в safe зоне); числа посчитает Game::minesPlaced
+        int placed = 0;
+
+        while (placed < game.MINES) {
+            int x = (int)(rng() % (unsigned)game.W);
+            int y = (int)(rng() % (unsigned)game.H);
+
+            if (game.isMine(x, y)) continue;
+            if (std::abs(x - safeX) <= 1 && std::abs(y - safeY) <= 1) continue;
+
+            game.placeMine(x, y);
+            placed++;
+        }
+    }
+};
+
+// Генератор под заданную сложность по 3BV (минимум кликов для решения:
+// число "проёмов" из нулей + числа, не граничащие ни с одним нулём).
+// Начинает со случайной расстановки и переносит мины по одной (отжиг).
+// Числа пересчитываются только в 3x3 вокруг перенесённой мины, вклад
+// одиночных чисел — в 5x5. Проёмы — только если какая-то клетка стала или
+// перестала быть нулём: заливкой от нулей в 5x5 до и после переноса, которая
+// останавливается, как только ясно, сколько там разных проёмов.
+class TargetBbbvBoardGenerator final : public IBoardGenerator {
+    int target;
+    int maxSteps;
+    std::mt19937 rng{std::random_device{}()};
+
+    int W = 0, H = 0;
+    std::vector<unsigned char> mine;
+    std::vector<unsigned char> num;  // мин среди соседей (у всех клеток, включая мины)
+    std::vector<int> minePos;        // где сейчас мины
+    std::vector<unsigned> stamp;
+    unsigned stampId = 0;
+    int openings = 0, isolated = 0;
+
+    // Заливка проёмов из нескольких семян (openingsThrough)
+    std::vector<unsigned> mark;
+    unsigned markId = 0;
+    std::vector<int> owner;              // семя, чья заливка дошла до клетки
+    std::vector<int> group;              // union-find по семенам
+    std::vector<std::vector<int>> fronts; // клетки, которые группа ещё не раскрыла
+    std::vector<int> seeds;
+
+    bool zero(int i) const { return !mine[i] && num[i] == 0; }
+
+    bool isIsolated(int i) const {
+        if (mine[i] || num[i] == 0) return false;
+        int x = i % W, y = i / W;
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = x + dx, ny = y + dy;
+                if ((dx || dy) && nx >= 0 && nx < W && ny >= 0 && ny < H && zero(ny * W + nx))
+                    return false;
+            }
+        return true;
+    }
+
+    int countOpenings() {
+        if (++stampId == 0) { stamp.assign(stamp.size(), 0); stampId = 1; }
+        int count = 0;
+        std::vector<int> stack;
+        for (int s = 0; s < W * H; s++) {
+            if (!zero(s) || stamp[s] == stampId) continue;
+            count++;
+            stamp[s] = stampId;
+            stack.push_back(s);
+            while (!stack.empty()) {
+                int i = stack.back(); stack.pop_back();
+                int x = i % W, y = i / W;
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx, ny = y + dy;
+                        if (nx < 0 || nx >= W || ny < 0 || ny >= H) continue;
+                        int n = ny * W + nx;
+                        if (zero(n) && stamp[n] != stampId) { stamp[n] = stampId; stack.push_back(n); }
+                    }
+            }
+        }
+        return count;
+    }
+
+    int findGroup(int g) {
+        while (group[g] != g) g = group[g] = group[group[g]];
+        return g;
+    }
+
+    void uniteGroups(int a, int b) {
+        a = findGroup(a); b = findGroup(b);
+        if (a == b) return;
+        if (fronts[a].size() < fronts[b].size()) std::swap(a, b);
+        fronts[a].insert(fronts[a].end(), fronts[b].begin(), fronts[b].end());
+        fronts[b].clear();
+        group[b] = a;
+    }
+
+    // Сколько разных проёмов (связных областей нулей) проходит через seeds.
+    // Заливки из всех семян растут по очереди, по клетке за шаг; встретившись,
+    // сливаются. Заливка, которой некуда расти, — проём целиком. Когда расти
+    // осталось одной группе, ответ известен: большой проём до конца не
+    // обходится, работа — порядка размера меньших проёмов у изменённых клеток.
+    int openingsThrough(const std::vector<int>& from) {
+        if (++markId == 0) { mark.assign(mark.size(), 0); markId = 1; }
+        int n = (int)from.size();
+        group.resize(n);
+        fronts.resize(n);
+        for (int s = 0; s < n; s++) {
+            group[s] = s;
+            fronts[s].clear();
+            int c = from[s];
+            if (mark[c] == markId) { uniteGroups(owner[c], s); continue; }
+            mark[c] = markId;
+            owner[c] = s;
+            fronts[s].push_back(c);
+        }
+        for (;;) {
+            int growing = 0;
+            for (int s = 0; s < n; s++) growing += findGroup(s) == s && !fronts[s].empty();
+            if (growing <= 1) break;
+            for (int s = 0; s < n; s++) {
+                if (findGroup(s) != s || fronts[s].empty()) continue;
+                int i = fronts[s].back();
+                fronts[s].pop_back();
+                int x = i % W, y = i / W;
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx, ny = y + dy;
+                        if (nx < 0 || nx >= W || ny < 0 || ny >= H) continue;
+                        int c = ny * W + nx;
+                        if (!zero(c)) continue;
+                        if (mark[c] == markId) { uniteGroups(owner[c], s); continue; }
+                        mark[c] = markId;
+                        owner[c] = findGroup(s);
+                        fronts[findGroup(s)].push_back(c);
+                    }
+            }
+        }
+        int count = 0;
+        for (int s = 0; s < n; s++) count += findGroup(s) == s;
+        return count;
+    }
+
+    // Нули в квадрате 5x5 вокруг from и to — через них проходят все проёмы,
+    // которые может изменить перенос мины
+    int openingsNear(int from, int to) {
+        seeds.clear();
+        forRegion(from, to, 2, [&](int i) { if (zero(i)) seeds.push_back(i); });
+        return openingsThrough(seeds);
+    }
+
+    // Сумма по квадрату радиуса r вокруг a и b (без повторов)
+    template <class F>
+    void forRegion(int a, int b, int r, F f) {
+        if (++stampId == 0) { stamp.assign(stamp.size(), 0); stampId = 1; }
+        for (int c : {a, b}) {
+            int x = c % W, y = c / W;
+            for (int dy = -r; dy <= r; dy++)
+                for (int dx = -r; dx <= r; dx++) {
+                    int nx = x + dx, ny = y + dy;
+                    if (nx < 0 || nx >= W || ny < 0 || ny >= H) continue;
+                    int n = ny * W + nx;
+                    if (stamp[n] == stampId) continue;
+                    stamp[n] = stampId;
+                    f(n);
+                }
+        }
+    }
+
+    void addAround(int c, int delta) {
+        int x = c % W, y = c / W;
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = x + dx, ny = y + dy;
+                if ((dx || dy) && nx >= 0 && nx < W && ny >= 0 && ny < H) num[ny * W + nx] += delta;
+            }
+    }
+
+    void placeMine(int from, int to) {
+        mine[from] = 0; addAround(from, -1);
+        mine[to] = 1;   addAround(to, +1);
+    }
+
+    // Перенос мины k из её клетки в клетку to; обратный ход — тот же вызов.
+    // 3BV пересчитывается только у клеток рядом с from и to
+    void moveMine(int k, int to) {
+        int from = minePos[k];
+
+        int isoBefore = 0;
+        forRegion(from, to, 2, [&](int i) { isoBefore += isIsolated(i); });
+        unsigned zeroBefore[18]; int zb = 0;
+        forRegion(from, to, 1, [&](int i) { zeroBefore[zb++] = zero(i); });
+
+        placeMine(from, to);
+        minePos[k] = to;
+
+        int isoAfter = 0;
+        forRegion(from, to, 2, [&](int i) { isoAfter += isIsolated(i); });
+        bool flipped = false; zb = 0;
+        forRegion(from, to, 1, [&](int i) { flipped |= zeroBefore[zb++] != (unsigned)zero(i); });
+
+        isolated += isoAfter - isoBefore;
+        if (flipped) {
+            // Проёмы рядом до переноса и после
+            placeMine(to, from);
+            int before = openingsNear(from, to);
+            placeMine(from, to);
+            openings += openingsNear(from, to) - before;
+        }
+    }
+
+public:
+    explicit TargetBbbvBoardGenerator(int target3bv, int steps = 200000)
+        : target(target3bv), maxSteps(steps) {}
+
+    void reseed(std::uint32_t seed) override { rng.seed(seed); }
+
+    int bbbv() const { return openings + isolated; }
+
+    void generate(Game& game, int safeX, int safeY) override {
+        W = game.W; H = game.H;
+        mine.assign((size_t)W * H, 0);
+        num.assign((size_t)W * H, 0);
+        stamp.assign((size_t)W * H, 0);
+        mark.assign((size_t)W * H, 0);
+        owner.assign((size_t)W * H, 0);
+        minePos.clear();
+
+        auto safe = [&](int i) { return std::abs(i % W - safeX) <= 1 && std::abs(i / W - safeY) <= 1; };
+
+        // Случайная стартовая расстановка (как у DefaultBoardGenerator)
+        while ((int)minePos.size() < game.MINES) {
+            int i = (int)(rng() % (unsigned)(W * H));
+            if (mine[i] || safe(i)) continue;
+            mine[i] = 1;
+            addAround(i, +1);
+            minePos.push_back(i);
+        }
+        openings = countOpenings();
+        isolated = 0;
+        for (int i = 0; i < W * H; i++) isolated += isIsolated(i);
+
+        // Отжиг: энергия — отклонение 3BV от цели
+        std::vector<int> best = minePos;
+        int bestErr = std::abs(bbbv() - target);
+        double temp = 2.0;
+        // Своё [0,1) вместо uniform_real_distribution: результат не зависит
+        // от стандартной библиотеки, и доска по зерну одинакова везде (повторы)
+        auto unit = [&] { return (rng() >> 8) * (1.0 / 16777216.0); };
+
+        for (int step = 0; step < maxSteps && bestErr > 0 && !minePos.empty(); step++, temp *= 0.9995) {
+            int k = (int)(rng() % minePos.size());
+            int to = (int)(rng() % (unsigned)(W * H));
+            if (mine[to] || safe(to)) continue;
+
+            int from = minePos[k];
+            int before = std::abs(bbbv() - target);
+            moveMine(k, to);
+            int after = std::abs(bbbv() - target);
+
+            if (after > before && unit() >= std::exp((before - after) / std::max(temp, 1e-3))) {
+                moveMine(k, from); // откат
+                continue;
+            }
+            if (after < bestErr) { bestErr = after; best = minePos; }
+        }
+
+        // Записываем лучшую расстановку в поле (числа и клетки — Game::minesPlaced)
+        for (int i : best) game.placeMine(i % W, i / W);
+    }
+};
+
+// Генератор с фиксированной расстановкой из файла (ручные и соревновательные
+// поля). Поле не подстраивается под первый клик. Числа для проверки файла
+// (BoardVerifier) считаются один раз при загрузке: сумма 3x3 по плоскости мин
+// минус сама клетка; в игре их считает хранилище правил.
+class FileBoardGenerator final : public IBoardGenerator {
+    BoardPlanes planes;
+    std::vector<unsigned char> numbers;
+public:
+    explicit FileBoardGenerator(BoardPlanes p) : planes(std::move(p)) {
+        std::vector<unsigned char> col;
+        boxSum3x3(planes.mine.data(), planes.W, planes.H, numbers, col);
+        for (size_t i = 0; i < numbers.size(); i++) numbers[i] -= planes.mine[i];
+    }
+
+    const BoardPlanes& board() const { return planes; }
+    const std::vector<unsigned char>& numberPlane() const { return numbers; }
+
+    // Игра создаётся под размер файла; другой размер — ошибка вызывающего
+    void generate(Game& game, int, int) override {
+        if (game.W != planes.W || game.H != planes.H)
+            throw std::invalid_argument("board file is " + std::to_string(planes.W) + "x" + std::to_string(planes.H)
+                                        + ", game is " + std::to_string(game.W) + "x" + std::to_string(game.H));
+        for (int y = 0; y < game.H; y++)
+            for (int x = 0; x < game.W; x++)
+                if (planes.mine[(size_t)game.index(x, y)]) game.placeMine(x, y);
+    }
+};
+
+// State implementations (State pattern concrete states)
+
+class ClosedState final : public ICellState {
+public:
+    void onLeftClick(Game& game, int x, int y) override {
+        // State pattern: закрытая клетка реагирует на ЛКМ как "открыть"
+        game.revealFromState(x, y);
+    }
+    void onRightClick(Game& game, int x, int y) override {
+        // State pattern: закрытая клетка реагирует на ПКМ как "флаг"
+        game.toggleFlagFromState(x, y);
+    }
+    bool isOpen() const override { return false; }
+    bool isFlagged() const override { return false; }
+};
+
+class OpenedState final : public ICellState {
+public:
+    void onLeftClick(Game&, int, int) override {}
+    void onRightClick(Game&, int, int) override {}
+    bool isOpen() const override { return true; }
+    bool isFlagged() const override { return false; }
+};
+
+class FlaggedState final : public ICellState {
+public:
+    void onLeftClick(Game&, int, int) override {}
+    void onRightClick(Game& game, int x, int y) override {
+        // State pattern: ПКМ на флаге -> снять флаг -> перейти в ClosedState
+        game.unflagFromState(x, y);
+    }
+    bool isOpen() const override { return false; }
+    bool isFlagged() const override { return true; }
+};
+
+// Фабрики состояний (облегчают переключение состояния)
+std::unique_ptr<ICellState> Game::makeClosedState()  { return std::make_unique<ClosedState>(); }
+std::unique_ptr<ICellState> Game::makeOpenedState()  { return std::make_unique<OpenedState>(); }
+std::unique_ptr<ICellState> Game::makeFlaggedState() { return std::make_unique<FlaggedState>(); }
+
+// Abstract Factory: начальная клетка (пустая и закрытая)
+Cell DefaultCellFactory::makeInitialCell() const {
+    Cell c;
+    c.content = CellContentFactory::makeEmpty();
+    c.state   = Game::makeClosedState();
+    return c;
+}
+
+// SOLVER (подсказки) — PATTERN: Strategy
+// Решатель смотрит только на видимое поле (открытые числа и флаги)
+// и выдаёт гарантированные выводы "здесь безопасно" / "здесь мина".
+
+struct Deduction {
+    int  x = 0, y = 0;
+    bool mine = false;
+};
+
+class ISolver {
+public:
+    virtual ~ISolver() = default;
+    // Следующий гарантированный ход; false — выводов нет
+    virtual bool nextMove(const Game& game, Deduction& out) = 0;
+};
+
+// Таблицы локальных шаблонов, считаются на этапе компиляции (constexpr).
+// Окно "одно число": ключ (осталось мин, закрытых соседей).
+// Окно "пара чисел" A,B на расстоянии <= 2: ключ (осталось у A, осталось у B,
+// закрытых только у A, только у B, общих). Это обобщает шаблоны 1-1, 1-2,
+// 1-2-1, 1-2-2-1 (последние два — цепочки перекрывающихся пар).
+struct PatternTables {
+    enum : unsigned char {
+        OnlyASafe = 1, OnlyAMine = 2,
+        OnlyBSafe = 4, OnlyBMine = 8,
+        SharedSafe = 16, SharedMine = 32
+    };
+    static constexpr int R = 9; // 0..8
+
+    unsigned char single[R * R] = {};
+    unsigned char pair[R * R * R * R * R] = {};
+
+    static constexpr int singleKey(int rem, int unknown) { return rem * R + unknown; }
+    static constexpr int pairKey(int remA, int remB, int onlyA, int onlyB, int shared) {
+        return (((remA * R + remB) * R + onlyA) * R + onlyB) * R + shared;
+    }
+};
+
+constexpr int ceMax(int a, int b) { return a > b ? a : b; }
+constexpr int ceMin(int a, int b) { return a < b ? a : b; }
+
+constexpr PatternTables buildPatternTables() {
+    PatternTables t{};
+    const int R = PatternTables::R;
+
+    for (int rem = 0; rem < R; rem++)
+        for (int unk = 1; unk < R; unk++) {
+            if (rem > unk) continue;
+            unsigned char r = 0;
+            if (rem == 0)   r |= PatternTables::OnlyASafe;
+            if (rem == unk) r |= PatternTables::OnlyAMine;
+            t.single[PatternTables::singleKey(rem, unk)] = r;
+        }
+
+    for (int ra = 0; ra < R; ra++)
+    for (int rb = 0; rb < R; rb++)
+    for (int oa = 0; oa < R; oa++)
+    for (int ob = 0; ob < R; ob++)
+    for (int sh = 0; sh < R; sh++) {
+        // s — сколько мин в общей части; перебираем допустимый диапазон
+        int sMin = ceMax(0, ceMax(ra - oa, rb - ob));
+        int sMax = ceMin(sh, ceMin(ra, rb));
+        if (sMin > sMax) continue; // противоречие — выводов нет
+
+        unsigned char r = 0;
+        if (oa > 0 && ra - sMin == 0)  r |= PatternTables::OnlyASafe;
+        if (oa > 0 && ra - sMax == oa) r |= PatternTables::OnlyAMine;
+        if (ob > 0 && rb - sMin == 0)  r |= PatternTables::OnlyBSafe;
+        if (ob > 0 && rb - sMax == ob) r |= PatternTables::OnlyBMine;
+        if (sh > 0 && sMax == 0)       r |= PatternTables::SharedSafe;
+        if (sh > 0 && sMin == sh)      r |= PatternTables::SharedMine;
+        t.pair[PatternTables::pairKey(ra, rb, oa, ob, sh)] = r;
+    }
+    return t;
+}
+
+static constexpr PatternTables kPatternTables = buildPatternTables();
+
+// Быстрая первая ступень решателя: кодирует окна вокруг недавно
+// изменённых клеток в ключи и берёт ответ из таблицы за O(1) на окно.
+class LocalPatternMatcher {
+    size_t   cursor_ = 0;
+    unsigned epoch_  = 0;
+
+    std::vector<unsigned> stamp_; // чтобы не смотреть одно число дважды за проход
+    unsigned stampId_ = 0;
+
+    struct Window {
+        int rem = 0;
+        int unknownCount = 0;
+        int unknown[8][2];
+    };
+
+    // Открытое число, рядом с которым ещё есть закрытые клетки
+    static bool frontierNumber(const Game& g, int x, int y) {
+        return g.frontierNumbers.contains(g.index(x, y));
+    }
+
+    static void readWindow(const Game& g, int x, int y, Window& w) {
+        int flags = 0;
+        w.unknownCount = 0;
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dx == 0 && dy == 0) continue;
+                int nx = x + dx, ny = y + dy;
+                if (nx < 0 || nx >= g.W || ny < 0 || ny >= g.H) continue;
+                const ICellState& s = *g.field[ny][nx].state;
+                if (s.isFlagged()) flags++;
+                else if (!s.isOpen()) {
+                    w.unknown[w.unknownCount][0] = nx;
+                    w.unknown[w.unknownCount][1] = ny;
+                    w.unknownCount++;
+                }
+            }
+        w.rem = g.field[y][x].content->number() - flags;
+    }
+
+    static bool touches(int ax, int ay, int bx, int by) {
+        return std::abs(ax - bx) <= 1 && std::abs(ay - by) <= 1;
+    }
+
+    static void emitAll(const Window& w, bool mine, std::vector<Deduction>& out) {
+        for (int i = 0; i < w.unknownCount; i++)
+            out.push_back({w.unknown[i][0], w.unknown[i][1], mine});
+    }
+
+    void matchSingle(const Window& a, std::vector<Deduction>& out) const {
+        if (a.rem < 0 || a.rem > a.unknownCount || a.unknownCount == 0) return;
+        unsigned char r = kPatternTables.single[PatternTables::singleKey(a.rem, a.unknownCount)];
+        if (r & PatternTables::OnlyASafe) emitAll(a, false, out);
+        if (r & PatternTables::OnlyAMine) emitAll(a, true, out);
+    }
+
+    void matchPair(int ax, int ay, const Window& a,
+                   int bx, int by, const Window& b, std::vector<Deduction>& out) const {
+        if (b.rem < 0 || b.rem > b.unknownCount) return;
+
+        int onlyA = 0, onlyB = 0, shared = 0;
+        for (int i = 0; i < a.unknownCount; i++)
+            (touches(a.unknown[i][0], a.unknown[i][1], bx, by) ? shared : onlyA)++;
+        for (int i = 0; i < b.unknownCount; i++)
+            if (!touches(b.unknown[i][0], b.unknown[i][1], ax, ay)) onlyB++;
+        if (shared == 0) return;
+
+        unsigned char r = kPatternTables.pair[
+            PatternTables::pairKey(a.rem, b.rem, onlyA, onlyB, shared)];
+        if (!r) return;
+
+        for (int i = 0; i < a.unknownCount; i++) {
+            bool sh = touches(a.unknown[i][0], a.unknown[i][1], bx, by);
+            if ((!sh && (r & PatternTables::OnlyASafe)) || (sh && (r & PatternTables::SharedSafe)))
+                out.push_back({a.unknown[i][0], a.unknown[i][1], false});
+            if ((!sh && (r & PatternTables::OnlyAMine)) || (sh && (r & PatternTables::SharedMine)))
+                out.push_back({a.unknown[i][0], a.unknown[i][1], true});
+        }
+        for (int i = 0; i < b.unknownCount; i++) {
+            if (touches(b.unknown[i][0], b.unknown[i][1], ax, ay)) continue;
+            if (r & PatternTables::OnlyBSafe) out.push_back({b.unknown[i][0], b.unknown[i][1], false});
+            if (r & PatternTables::OnlyBMine) out.push_back({b.unknown[i][0], b.unknown[i][1], true});
+        }
+    }
+
+    void matchAround(const Game& g, int x, int y, std::vector<Deduction>& out) {
+        Window a;
+        readWindow(g, x, y, a);
+        if (a.unknownCount == 0) return;
+        matchSingle(a, out);
+        if (a.rem < 0 || a.rem > a.unknownCount) return; // лишние флаги — пары не смотрим
+
+        Window b;
+        for (int dy = -2; dy <= 2; dy++)
+            for (int dx = -2; dx <= 2; dx++) {
+                if (dx == 0 && dy == 0) continue;
+                int bx = x + dx, by = y + dy;
+                if (bx < 0 || bx >= g.W || by < 0 || by >= g.H) continue;
+                if (!frontierNumber(g, bx, by)) continue;
+                readWindow(g, bx, by, b);
+                matchPair(x, y, a, bx, by, b, out);
+            }
+    }
+
+public:
+    size_t bytes() const { return vectorBytes(stamp_); }
+
+    // Сбросить кэш: следующий collect заново пройдёт журнал с начала
+    void release() {
+        std::vector<unsigned>().swap(stamp_);
+        epoch_ = 0;
+    }
+
+    // Проверяет окна, затронутые изменениями с прошлого вызова.
+    // Изменение клетки влияет на числа в радиусе 1; пара (A,B) проверяется
+    // с той стороны, чьё окно изменилось, и выдаёт выводы для обеих.
+    void collect(const Game& g, std::vector<Deduction>& out) {
+        if (epoch_ != g.boardEpoch || cursor_ > g.changeLog.size()) {
+            epoch_ = g.boardEpoch;
+            cursor_ = 0;
+            stamp_.assign((size_t)g.W * g.H, 0);
+        }
+        if (++stampId_ == 0) { stamp_.assign(stamp_.size(), 0); stampId_ = 1; }
+
+        for (; cursor_ < g.changeLog.size(); cursor_++) {
+            int cx = g.changeLog[cursor_] % g.W;
+            int cy = g.changeLog[cursor_] / g.W;
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++) {
+                    int x = cx + dx, y = cy + dy;
+                    if (x < 0 || x >= g.W || y < 0 || y >= g.H) continue;
+                    unsigned& st = stamp_[g.index(x, y)];
+                    if (st == stampId_) continue;
+                    st = stampId_;
+                    if (frontierNumber(g, x, y)) matchAround(g, x, y, out);
+                }
+        }
+    }
+};
+
+static inline int popcount64(std::uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((v * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+static inline int ctz64(std::uint64_t v) { // v != 0
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(v);
+#else
+    return popcount64((v & (~v + 1)) - 1);
+#endif
+}
+
+// Точный перебор компоненты фронтира "по битовым срезам":
+// одно 64-битное слово хранит 64 расстановки сразу. Младшие 6 переменных
+// меняются по дорожкам слова (маски 0xAAAA..., 0xCCCC..., ...), старшие
+// постоянны в пределах слова и перебираются поиском в глубину.
+class BitSlicedEnumerator {
+    static constexpr std::uint64_t kLane[6] = {
+        0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+        0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull
+    };
+
+public:
+    static constexpr int kMaxUnknowns = 30;
+
+    struct Constraint {
+        std::uint32_t vars; // какие переменные компоненты соседствуют с числом
+        int rem;            // сколько мин среди них должно быть
+    };
+
+    // counts[i] — сколько допустимых расстановок, где переменная i — мина.
+    // Возвращает общее число допустимых расстановок.
+    static std::uint64_t enumerate(int k, const std::vector<Constraint>& cons,
+                                   std::uint64_t* counts)
+    {
+        const int low = k < 6 ? k : 6;
+        const int high = k - low;
+        const std::uint64_t laneMask = low == 6 ? ~0ull : ((1ull << (1 << low)) - 1);
+
+        for (int i = 0; i < k; i++) counts[i] = 0;
+
+        // Сумма младших переменных в каждом ограничении — побитовым сумматором
+        // (3 битовые плоскости, максимум 6). eq[c][v] — дорожки, где сумма == v.
+        std::vector<std::array<std::uint64_t, 7>> eq(cons.size());
+        std::vector<std::uint32_t> hiVars(cons.size());
+        for (size_t c = 0; c < cons.size(); c++) {
+            std::uint64_t s0 = 0, s1 = 0, s2 = 0;
+            for (int i = 0; i < low; i++) {
+                if (!(cons[c].vars >> i & 1u)) continue;
+                std::uint64_t carry = kLane[i], t;
+                t = s0 & carry; s0 ^= carry; carry = t;
+                t = s1 & carry; s1 ^= carry; carry = t;
+                s2 ^= carry;
+            }
+            for (int v = 0; v <= 6; v++) {
+                std::uint64_t t0 = (v & 1) ? ~0ull : 0, t1 = (v & 2) ? ~0ull : 0, t2 = (v & 4) ? ~0ull : 0;
+                eq[c][v] = ~(s0 ^ t0) & ~(s1 ^ t1) & ~(s2 ^ t2) & laneMask;
+            }
+            hiVars[c] = cons[c].vars >> low;
+        }
+
+        // Старшие переменные перебираем в глубину: ограничение проверяется,
+        // как только назначена его последняя старшая переменная, — так
+        // целые поддеревья отсекаются, не доходя до листьев.
+        Search st{low, high, counts, {}, {}, cons, hiVars, eq};
+        st.closing.resize(high);
+        std::uint64_t valid = laneMask;
+        for (size_t c = 0; c < cons.size(); c++) {
+            if (hiVars[c] != 0) st.closing[31 - clz32(hiVars[c])].push_back((int)c);
+            else if (cons[c].rem < 0 || cons[c].rem > 6) valid = 0;
+            else valid &= eq[c][cons[c].rem];
+        }
+        if (valid) st.dfs(0, 0, valid);
+        return st.total;
+    }
+
+private:
+    static int clz32(std::uint32_t v) { // v != 0
+        int n = 0;
+        while (!(v & 0x80000000u)) { v <<= 1; n++; }
+        return n;
+    }
+
+    struct Search {
+        int low, high;
+        std::uint64_t* counts;
+        std::uint64_t total;
+        std::vector<std::vector<int>> closing; // старшая переменная -> ограничения
+        const std::vector<Constraint>& cons;
+        const std::vector<std::uint32_t>& hiVars;
+        const std::vector<std::array<std::uint64_t, 7>>& eq;
+
+        void dfs(int j, std::uint32_t w, std::uint64_t valid) {
+            if (j == high) {
+                std::uint64_t n = (std::uint64_t)popcount64(valid);
+                total += n;
+                for (int i = 0; i < low; i++) counts[i] += (std::uint64_t)popcount64(valid & kLane[i]);
+                for (std::uint32_t hw = w; hw; hw &= hw - 1)
+                    counts[low + ctz64(hw)] += n;
+                return;
+            }
+            for (std::uint32_t bit = 0; bit <= 1; bit++) {
+                std::uint32_t w2 = w | (bit << j);
+                std::uint64_t v = valid;
+                for (size_t i = 0; i < closing[j].size() && v; i++) {
+                    int c = closing[j][i];
+                    int need = cons[c].rem - popcount64(w2 & hiVars[c]);
+                    v = (need < 0 || need > 6) ? 0 : (v & eq[c][need]);
+                }
+                if (v) dfs(j + 1, w2, v);
+            }
+        }
+    };
+};
+
+struct CellOdds {
+    int   x = 0, y = 0;
+    float pMine = 0.0f;
+};
+
+// Вторая ступень решателя: фронтир делится на независимые компоненты
+// (закрытые клетки, связанные общими числами), каждая перебирается точно.
+class ExactFrontierSolver {
+    std::vector<int> varOf;  // клетка -> номер переменной или -1
+    std::vector<int> parent; // union-find по переменным
+
+    int find(int v) {
+        while (parent[v] != v) { parent[v] = parent[parent[v]]; v = parent[v]; }
+        return v;
+    }
+
+public:
+    size_t bytes() const { return vectorBytes(varOf) + vectorBytes(parent); }
+
+    void release() {
+        std::vector<int>().swap(varOf);
+        std::vector<int>().swap(parent);
+    }
+
+    void analyze(const Game& g, std::vector<Deduction>& out, std::vector<CellOdds>* odds = nullptr) {
+        // Фронтир ведёт сам Game — обход стоит O(фронтира), а не O(W*H)
+        if (varOf.size() != (size_t)g.W * g.H) varOf.assign((size_t)g.W * g.H, -1);
+        std::vector<int> vars;                                  // индексы клеток-переменных
+        const std::vector<int>& numbers = g.frontierNumbers.items(); // числа с закрытыми соседями
+
+        for (int num : numbers)
+            g.forEachNeighbor(num % g.W, num / g.W, [&](int nx, int ny, int n) {
+                const ICellState& s = *g.field[ny][nx].state;
+                if (s.isOpen() || s.isFlagged() || varOf[n] >= 0) return;
+                varOf[n] = (int)vars.size();
+                vars.push_back(n);
+            });
+
+        parent.resize(vars.size());
+        for (size_t i = 0; i < vars.size(); i++) parent[i] = (int)i;
+
+        // Соседи каждого числа попадают в одну компоненту
+        std::vector<std::array<int, 8>> around(numbers.size());
+        std::vector<int> aroundCount(numbers.size(), 0), rem(numbers.size(), 0);
+        for (size_t n = 0; n < numbers.size(); n++) {
+            int x = numbers[n] % g.W, y = numbers[n] / g.W;
+            int flags = 0;
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = x + dx, ny = y + dy;
+                    if (!(dx || dy) || nx < 0 || nx >= g.W || ny < 0 || ny >= g.H) continue;
+                    if (g.field[ny][nx].state->isFlagged()) flags++;
+                    int v = varOf[g.index(nx, ny)];
+                    if (v >= 0) around[n][aroundCount[n]++] = v;
+                }
+            rem[n] = g.field[y][x].content->number() - flags;
+            for (int i = 1; i < aroundCount[n]; i++) {
+                int a = find(around[n][0]), b = find(around[n][i]);
+                if (a != b) parent[a] = b;
+            }
+        }
+
+        // Собираем компоненты: локальная нумерация переменных и ограничения
+        std::vector<int> compOf(vars.size()), local(vars.size());
+        std::vector<std::vector<int>> compVars;
+        std::vector<int> compId(vars.size(), -1);
+        for (size_t v = 0; v < vars.size(); v++) {
+            int r = find((int)v);
+            if (compId[r] < 0) { compId[r] = (int)compVars.size(); compVars.emplace_back(); }
+            compOf[v] = compId[r];
+            local[v] = (int)compVars[compOf[v]].size();
+            compVars[compOf[v]].push_back((int)v);
+        }
+
+        std::vector<std::vector<BitSlicedEnumerator::Constraint>> compCons(compVars.size());
+        for (size_t n = 0; n < numbers.size(); n++) {
+            int c = compOf[around[n][0]];
+            if ((int)compVars[c].size() > BitSlicedEnumerator::kMaxUnknowns) continue; // не перебирается
+            std::uint32_t mask = 0;
+            for (int i = 0; i < aroundCount[n]; i++) mask |= 1u << local[around[n][i]];
+            compCons[c].push_back({mask, rem[n]});
+        }
+
+        std::uint64_t counts[BitSlicedEnumerator::kMaxUnknowns];
+        for (size_t c = 0; c < compVars.size(); c++) {
+            int k = (int)compVars[c].size();
+            if (k > BitSlicedEnumerator::kMaxUnknowns) continue; // слишком большая — пропускаем
+            std::uint64_t total = BitSlicedEnumerator::enumerate(k, compCons[c], counts);
+            if (total == 0) continue; // противоречие (неверные флаги)
+
+            for (int i = 0; i < k; i++) {
+                int cell = vars[compVars[c][i]];
+                int x = cell % g.W, y = cell / g.W;
+                if (counts[i] == 0)     out.push_back({x, y, false});
+                if (counts[i] == total) out.push_back({x, y, true});
+                if (odds) odds->push_back({x, y, (float)counts[i] / (float)total});
+            }
+        }
+
+        for (int cell : vars) varOf[cell] = -1;
+    }
+};
+
+class DefaultSolver final : public ISolver {
+    LocalPatternMatcher patterns;
+    ExactFrontierSolver exact;
+    std::vector<Deduction> found;           // сырые выводы ступеней (с повторами)
+    std::vector<Deduction> safeQ, mineQ;    // очереди без повторов
+    std::vector<unsigned char> queued;      // клетка уже стоит в очереди
+    unsigned epoch_ = 0;
+    mutable size_t peakMemory = 0;
+
+    static bool stillUnknown(const Game& g, const Deduction& d) {
+        const ICellState& s = *g.field[d.y][d.x].state;
+        return !s.isOpen() && !s.isFlagged();
+    }
+
+public:
+    bool nextMove(const Game& game, Deduction& out) override {
+        if (game.gameOver || game.win || game.firstClick) return false;
+        if (epoch_ != game.boardEpoch) {
+            epoch_ = game.boardEpoch;
+            safeQ.clear();
+            mineQ.clear();
+            queued.assign((size_t)game.W * game.H, 0);
+        }
+
+        // 1 ступень: локальные шаблоны по свежим изменениям
+        patterns.collect(game, found);
+        enqueue(game);
+        if (takeQueued(game, out)) return true;
+
+        // 2 ступень: точный перебор компонент фронтира
+        exact.analyze(game, found);
+        enqueue(game);
+        return takeQueued(game, out);
+    }
+
+    MemoryUsage memoryUsage() const {
+        MemoryUsage u("solver", 0);
+        u.add(MemoryUsage("pattern stamps", patterns.bytes()));
+        u.add(MemoryUsage("frontier enumeration", exact.bytes()));
+        u.add(MemoryUsage("deduction queues", vectorBytes(found) + vectorBytes(safeQ) + vectorBytes(mineQ)
+                                              + vectorBytes(queued)));
+        return u.track(peakMemory);
+    }
+
+    // Кэши пересобираются при следующем ходе (выводы найдутся заново); вернёт освобождённые байты
+    size_t releaseCaches() {
+        size_t freed = memoryUsage().live;
+        patterns.release();
+        exact.release();
+        std::vector<Deduction>().swap(found);
+        std::vector<Deduction>().swap(safeQ);
+        std::vector<Deduction>().swap(mineQ);
+        std::vector<unsigned char>().swap(queued);
+        epoch_ = 0;
+        return freed;
+    }
+
+private:
+    void enqueue(const Game& game) {
+        for (const Deduction& d : found) {
+            unsigned char& q = queued[game.index(d.x, d.y)];
+            if (q) continue;
+            q = 1;
+            (d.mine ? mineQ : safeQ).push_back(d);
+        }
+        found.clear();
+    }
+
+    bool takeQueued(const Game& game, Deduction& out) {
+        // Сначала безопасные клетки, потом мины
+        for (std::vector<Deduction>* q : {&safeQ, &mineQ})
+            while (!q->empty()) {
+                Deduction d = q->back();
+                q->pop_back();
+                queued[game.index(d.x, d.y)] = 0;
+                if (!stillUnknown(game, d)) continue;
+                out = d;
+                return true;
+            }
+        return false;
+    }
+};
+
+// PRESETS (размеры поля по сложности)
+
+struct GamePreset {
+    int W = 10, H = 10, MINES = 10;
+};
+
+static GamePreset presetByDifficulty(int choice) {
+    switch (choice) {
+        case 2: return {14, 14, 20};
+        case 3: return {20, 20, 40};
+        default: return {10, 10, 10};
+    }
+}
+
+// Strategy генерации по параметру: target3bv > 0 — доска под заданный 3BV
+static std::unique_ptr<IBoardGenerator> makeBoardGenerator(int target3bv) {
+    if (target3bv > 0) return std::make_unique<TargetBbbvBoardGenerator>(target3bv);
+    return std::make_unique<DefaultBoardGenerator>();
+}
+
+// Перемешивание номера партии в зерно генератора (splitmix64)
+static std::uint32_t mixSeed(std::uint64_t v) {
+    v += 0x9E3779B97F4A7C15ull;
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+    return (std::uint32_t)(v ^ (v >> 31));
+}
+
+// PARALLEL (простой пул потоков)
+// count задач раздаются рабочим потокам через атомарный счётчик.
+// task(i, worker) — worker нужен, чтобы у каждого потока были свои данные.
+// С --pin-workers поток worker закреплён за своим ядром (MemoryPlacement).
+
+static unsigned workerCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+template <class F>
+static void parallelFor(int count, F&& task) {
+    unsigned n = std::min<unsigned>(workerCount(), (unsigned)std::max(count, 1));
+    std::atomic<int> next{0};
+    std::vector<std::thread> workers;
+    bool pin = MemoryPlacement::instance().pinWorkers;
+    for (unsigned w = 0; w < n; w++)
+        workers.emplace_back([&, w] {
+            if (pin) pinCurrentThread(w);
+            for (int i; (i = next++) < count;) task(i, (int)w);
+        });
+    for (auto& t : workers) t.join();
+}
+
+// ASYNC I/O — общий для всех писателей сервис записи файлов (Singleton).
+// Кадр игры и рабочие потоки симулятора только ставят запросы в очередь,
+// а пишет фоновый поток. Запросы, пришедшие вместе, обрабатываются одной
+// пачкой: подряд идущие дозаписи в один файл — одним открытием файла,
+// fsync (если нужен) — один раз на файл за пачку (групповой коммит).
+// Буферы после записи возвращаются в пул и переиспользуются.
+// Способ записи (Options::backend, ключ --io): на Linux — io_uring (вся пачка
+// одной отправкой в ядро), иначе или если кольцо не создалось — fwrite
+// в фоновом потоке.
+
+#if defined(SAPPER_IO_URING)
+// IO_URING — очереди отправки и завершения общие с ядром (mmap): запись
+// ставится в кольцо без системного вызова, один io_uring_enter отправляет
+// пачку и ждёт завершений. Без liburing: io_uring_setup, io_uring_enter
+// и io_uring_register — прямые системные вызовы. Кольцо — одного потока.
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring() { close(); }
+
+    // Завершения с прошлого finish(): user_data и результат (байты или -errno)
+    std::vector<std::pair<std::uint64_t, int>> done;
+
+    // false — ядро без io_uring (или он запрещён) либо старше 5.6 (IORING_OP_WRITE)
+    bool open(unsigned want) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        int fd = (int)syscall(__NR_io_uring_setup, want, &p);
+        if (fd < 0) return false;
+        ringFd = fd;
+        if (!(p.features & IORING_FEAT_RW_CUR_POS)) { close(); return false; }
+        sqLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqLen = cqLen = std::max(sqLen, cqLen);
+        sqMap = map(sqLen, IORING_OFF_SQ_RING);
+        cqMap = single ? sqMap : map(cqLen, IORING_OFF_CQ_RING);
+        sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = map(sqesLen, IORING_OFF_SQES);
+        if (!sqMap || !cqMap || !s) { if (s) munmap(s, sqesLen); close(); return false; }
+        sqes = (io_uring_sqe*)s;
+
+        unsigned char* sq = (unsigned char*)sqMap;
+        unsigned char* cq = (unsigned char*)cqMap;
+        sqHead = (unsigned*)(sq + p.sq_off.head);
+        sqTail = (unsigned*)(sq + p.sq_off.tail);
+        sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + p.sq_off.array);
+        cqHead = (unsigned*)(cq + p.cq_off.head);
+        cqTail = (unsigned*)(cq + p.cq_off.tail);
+        cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        entries = p.sq_entries;
+        return true;
+    }
+
+    bool ready() const { return ringFd >= 0; }
+
+    // Буферы для WRITE_FIXED (индекс — позиция в iovs): страницы закрепляются
+    // один раз на все операции с ними; пустой список — снять регистрацию
+    bool registerBuffers(const std::vector<iovec>& iovs) {
+        if (registered) syscall(__NR_io_uring_register, ringFd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        registered = !iovs.empty()
+            && syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, iovs.data(), (unsigned)iovs.size()) == 0;
+        return registered;
+    }
+
+    // bufIndex >= 0 — данные лежат в зарегистрированном буфере с этим индексом
+    void write(int fd, const unsigned char* data, unsigned len, std::uint64_t offset, int bufIndex,
+               std::uint64_t user) {
+        io_uring_sqe e;
+        std::memset(&e, 0, sizeof(e));
+        e.opcode = bufIndex >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        e.fd = fd;
+        e.addr = (std::uint64_t)(std::uintptr_t)data;
+        e.len = len;
+        e.off = offset;
+        e.buf_index = (std::uint16_t)std::max(bufIndex, 0);
+        e.user_data = user;
+        push(e);
+    }
+
+    // fsync после всех поставленных раньше операций (IOSQE_IO_DRAIN)
+    void fsync(int fd, std::uint64_t user) {
+        io_uring_sqe e;
+        std::memset(&e, 0, sizeof(e));
+        e.opcode = IORING_OP_FSYNC;
+        e.flags = IOSQE_IO_DRAIN;
+        e.fd = fd;
+        e.user_data = user;
+        push(e);
+    }
+
+    // Отправить поставленное и дождаться всех завершений (они — в done);
+    // false — кольцо сломалось, его больше не использовать
+    bool finish() {
+        while (pending + inFlight > 0)
+            if (!enter(1)) return false;
+        return !broken;
+    }
+
+    void close() {
+        if (sqes) munmap(sqes, sqesLen);
+        if (cqMap && cqMap != sqMap) munmap(cqMap, cqLen);
+        if (sqMap) munmap(sqMap, sqLen);
+        if (ringFd >= 0) ::close(ringFd);
+        sqes = nullptr;
+        sqMap = cqMap = nullptr;
+        ringFd = -1;
+        registered = false;
+        pending = inFlight = 0;
+    }
+
+private:
+    int ringFd = -1;
+    void* sqMap = nullptr;
+    void* cqMap = nullptr;
+    size_t sqLen = 0, cqLen = 0, sqesLen = 0;
+    io_uring_sqe* sqes = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqArray = nullptr, *cqHead = nullptr, *cqTail = nullptr;
+    unsigned sqMask = 0, cqMask = 0, entries = 0;
+    unsigned pending = 0, inFlight = 0; // поставлено, но не отправлено; отправлено, но не завершено
+    bool registered = false;
+    bool broken = false;
+
+    void* map(size_t len, off_t offset) {
+        void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void push(const io_uring_sqe& e) {
+        // Мест в кольце нет — отправляем и ждём хотя бы одно завершение;
+        // завершений в полёте не больше entries, очередь завершений (2x) не переполнится
+        while (pending + inFlight >= entries && !broken)
+            if (!enter(1)) broken = true;
+        if (broken) {
+            done.push_back({e.user_data, -EIO});
+            return;
+        }
+        unsigned tail = *sqTail, idx = tail & sqMask;
+        sqes[idx] = e;
+        sqArray[idx] = idx;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE); // ядро видит заполненную запись
+        pending++;
+    }
+
+    bool enter(unsigned minComplete) {
+        if (broken) return false;
+        long n = syscall(__NR_io_uring_enter, ringFd, pending, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) { broken = true; return false; }
+        if (n > 0) { pending -= (unsigned)n; inFlight += (unsigned)n; }
+        unsigned head = *cqHead, tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe& c = cqes[head & cqMask];
+            done.push_back({c.user_data, c.res});
+            inFlight--;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+#endif
+
+class AsyncIoService {
+public:
+    enum class Mode  { Truncate, Append };
+    // Never — без fsync; Always — fsync до done (один на файл за пачку);
+    // Interval — fsync файла не чаще раза в Options::syncIntervalMs: done
+    // приходит после записи, на диск данные попадают не позже интервала
+    // (групповой коммит по времени — для частых мелких дозаписей)
+    enum class Fsync { Never, Always, Interval };
+    enum class Backend { Threads, IoUring };
+
+    // До первого instance() (ключи --io threads|uring и --sync-interval MS)
+    struct Options {
+        Backend backend = Backend::IoUring;
+        int     syncIntervalMs = 1000;
+    };
+    static Options& options() {
+        static Options o;
+        return o;
+    }
+
+    struct Request {
+        std::string path;
+        std::vector<unsigned char> data;
+        Mode  mode = Mode::Append;
+        Fsync fsync = Fsync::Never;
+        std::function<void(bool ok)> done; // вызывается из потока записи
+    };
+
+    struct Metrics {
+        Backend       backend = Backend::Threads;
+        size_t        queueDepth = 0, maxQueueDepth = 0;
+        std::uint64_t completed = 0, failed = 0, bytes = 0, batches = 0;
+        std::uint64_t fixedWrites = 0;      // из зарегистрированных буферов (io_uring)
+        std::uint64_t syncs = 0, syncErrors = 0;
+        double        avgLatencyMs = 0.0, maxLatencyMs = 0.0; // от постановки до записи
+    };
+
+    static AsyncIoService& instance() {
+        static AsyncIoService service;
+        return service;
+    }
+
+    // Буфер из пула (пустой, но с уже выделенной памятью)
+    std::vector<unsigned char> takeBuffer() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (pool.empty()) return {};
+        std::vector<unsigned char> b = std::move(pool.back());
+        pool.pop_back();
+        b.clear();
+        return b;
+    }
+
+    void submit(Request r) {
+        std::lock_guard<std::mutex> lock(mtx);
+        enqueue(std::move(r));
+        cv.notify_all();
+    }
+
+    void submitBatch(std::vector<Request>& rs) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (Request& r : rs) enqueue(std::move(r));
+        rs.clear();
+        cv.notify_all();
+    }
+
+    // Поставить и дождаться результата
+    bool submitAndWait(Request r) {
+        std::mutex m;
+        std::condition_variable done;
+        bool finished = false, ok = false;
+        auto user = std::move(r.done);
+        r.done = [&](bool res) {
+            if (user) user(res);
+            std::lock_guard<std::mutex> lock(m);
+            ok = res;
+            finished = true;
+            done.notify_all();
+        };
+        submit(std::move(r));
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [&] { return finished; });
+        return ok;
+    }
+
+    // Дождаться, пока очередь опустеет (отложенные fsync Interval не ждёт)
+    void drain() {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return queue.empty() && !writing; });
+    }
+
+    Metrics metrics() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        Metrics m = stats;
+        m.queueDepth = queue.size();
+        m.avgLatencyMs = stats.completed ? latencySumMs / (double)stats.completed : 0.0;
+        return m;
+    }
+
+    // Очередь — данные ещё не записанных запросов; пул — буферы для повторного использования
+    MemoryUsage memoryUsage() const {
+        std::lock_guard<std::mutex> lock(mtx);
+        size_t queued = vectorBytes(queue), pooled = vectorBytes(pool);
+        for (const Pending& p : queue) queued += p.req.data.capacity() + p.req.path.capacity();
+        for (const std::vector<unsigned char>& b : pool) pooled += b.capacity();
+        MemoryUsage u("async io", 0);
+        u.add(MemoryUsage("queue", queued));
+        u.add(MemoryUsage("buffer pool", pooled));
+        return u.track(peakMemory);
+    }
+
+    // Отдать буферы пула системе; вернёт освобождённые байты
+    size_t trimPool() {
+        std::lock_guard<std::mutex> lock(mtx);
+        size_t freed = vectorBytes(pool);
+        for (const std::vector<unsigned char>& b : pool) freed += b.capacity();
+        std::vector<std::vector<unsigned char>>().swap(pool);
+        return freed;
+    }
+
+    ~AsyncIoService() {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return queue.empty() && !writing; });
+            stopping = true;
+            cv.notify_all();
+        }
+        worker.join(); // отложенные fsync поток делает перед выходом
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        Request req;
+        Clock::time_point queued;
+    };
+
+    // Файл с fsync по интервалу (только поток записи)
+    struct IntervalFile {
+        std::string path;
+        Clock::time_point lastSync;
+        bool dirty = false; // записано после lastSync
+    };
+
+    // Подряд идущие запросы пачки в один файл: [from, to)
+    struct Group {
+        size_t from = 0, to = 0;
+        bool sync = false;
+    };
+
+    static constexpr size_t kFixedMin = (size_t)64 << 10; // меньшие буферы не регистрируем
+    static constexpr size_t kFixedMax = 16;                // буферов на пачку
+    static constexpr size_t kRingMaxWrite = (size_t)1 << 30; // байт за операцию кольца
+
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<Pending> queue;
+    std::vector<std::vector<unsigned char>> pool;
+    bool writing = false, stopping = false;
+    Metrics stats;
+    double latencySumMs = 0.0;
+    mutable size_t peakMemory = 0;
+    std::vector<IntervalFile> intervalFiles;
+#if defined(SAPPER_IO_URING)
+    IoUring ring;
+#endif
+    std::thread worker;
+
+    AsyncIoService() {
+#if defined(SAPPER_IO_URING)
+        if (options().backend == Backend::IoUring && ring.open(64)) stats.backend = Backend::IoUring;
+#endif
+        worker = std::thread([this] { run(); });
+    }
+
+    void enqueue(Request&& r) {
+        queue.push_back({std::move(r), Clock::now()});
+        stats.maxQueueDepth = std::max(stats.maxQueueDepth, queue.size());
+    }
+
+    Clock::duration syncInterval() const { return std::chrono::milliseconds(std::max(0, options().syncIntervalMs)); }
+
+    static bool syncFile(std::FILE* f) {
+        if (std::fflush(f) != 0) return false;
+#if defined(_WIN32)
+        return _commit(_fileno(f)) == 0;
+#else
+        return fsync(fileno(f)) == 0;
+#endif
+    }
+
+    // Группы пачки и решение о fsync: Always — всегда, Interval — если
+    // с прошлого fsync файла прошёл интервал (иначе файл ждёт syncDue)
+    std::vector<Group> groupBatch(const std::vector<Pending>& batch, Clock::time_point now) {
+        std::vector<Group> groups;
+        for (size_t i = 0; i < batch.size();) {
+            Group g;
+            g.from = i;
+            g.to = i + 1;
+            while (g.to < batch.size() && batch[g.to].req.path == batch[i].req.path
+                   && batch[g.to].req.mode == Mode::Append) g.to++;
+            bool interval = false;
+            for (size_t k = g.from; k < g.to; k++) {
+                g.sync = g.sync || batch[k].req.fsync == Fsync::Always;
+                interval = interval || batch[k].req.fsync == Fsync::Interval;
+            }
+            if (interval) {
+                IntervalFile& f = intervalFile(batch[i].req.path);
+                if (g.sync || now - f.lastSync >= syncInterval()) { g.sync = true; f.lastSync = now; f.dirty = false; }
+                else f.dirty = true;
+            }
+            groups.push_back(g);
+            i = g.to;
+        }
+        return groups;
+    }
+
+    IntervalFile& intervalFile(const std::string& path) {
+        for (IntervalFile& f : intervalFiles)
+            if (f.path == path) return f;
+        intervalFiles.push_back({path, Clock::time_point(), false});
+        return intervalFiles.back();
+    }
+
+    // Ближайший срок отложенного fsync; false — таких файлов нет
+    bool nextSyncDue(Clock::time_point& due) const {
+        bool any = false;
+        for (const IntervalFile& f : intervalFiles)
+            if (f.dirty && (!any || f.lastSync + syncInterval() < due)) { due = f.lastSync + syncInterval(); any = true; }
+        return any;
+    }
+
+    // Отложенные fsync (Interval), срок которых вышел; all — все (выход)
+    void syncDue(bool all) {
+        Clock::time_point now = Clock::now();
+        for (IntervalFile& f : intervalFiles) {
+            if (!f.dirty || (!all && now - f.lastSync < syncInterval())) continue;
+            std::FILE* file = std::fopen(f.path.c_str(), "ab");
+            bool ok = file && syncFile(file);
+            if (file) ok = (std::fclose(file) == 0) && ok;
+            f.dirty = false;
+            f.lastSync = now;
+            std::lock_guard<std::mutex> lock(mtx);
+            stats.syncs++;
+            if (!ok) stats.syncErrors++;
+        }
+    }
+
+    // Запасной способ: fwrite из потока записи, одно открытие файла на группу
+    void writeStdio(const std::vector<Pending>& batch, const std::vector<Group>& groups, std::vector<char>& ok) {
+        for (const Group& g : groups) {
+            std::FILE* f = std::fopen(batch[g.from].req.path.c_str(),
+                                      batch[g.from].req.mode == Mode::Append ? "ab" : "wb");
+            bool good = f != nullptr;
+            for (size_t k = g.from; k < g.to && good; k++) {
+                const std::vector<unsigned char>& d = batch[k].req.data;
+                good = d.empty() || std::fwrite(d.data(), 1, d.size(), f) == d.size();
+            }
+            if (f) {
+                if (good && g.sync) {
+                    good = syncFile(f);
+                    std::lock_guard<std::mutex> lock(mtx);
+                    stats.syncs++;
+                    if (!good) stats.syncErrors++;
+                }
+                good = (std::fclose(f) == 0) && good;
+            }
+            for (size_t k = g.from; k < g.to; k++) ok[k] = good;
+        }
+    }
+
+#if defined(SAPPER_IO_URING)
+    // io_uring: файлы пачки открываются, все записи (с явными смещениями —
+    // порядок завершения не важен) и fsync уходят одной отправкой. Крупные
+    // буферы пачки на это время регистрируются (WRITE_FIXED): ими владеет
+    // поток записи, и до возврата в пул их никто не освободит и не сдвинет.
+    // false — кольцо сломалось (результаты пачки уже в ok, дальше — stdio)
+    bool writeRing(const std::vector<Pending>& batch, const std::vector<Group>& groups, std::vector<char>& ok) {
+        std::vector<iovec> fixed;
+        std::vector<int> fixedIndex(batch.size(), -1);
+        for (size_t k = 0; k < batch.size() && fixed.size() < kFixedMax; k++) {
+            const std::vector<unsigned char>& d = batch[k].req.data;
+            if (d.size() < kFixedMin || d.size() > kRingMaxWrite) continue;
+            fixedIndex[k] = (int)fixed.size();
+            fixed.push_back({(void*)d.data(), d.size()});
+        }
+        // Не хватило RLIMIT_MEMLOCK — пишем без регистрации
+        if (!fixed.empty() && !ring.registerBuffers(fixed)) std::fill(fixedIndex.begin(), fixedIndex.end(), -1);
+
+        // user_data: индекс запроса; fsync группы gi — kSyncTag | gi
+        const std::uint64_t kSyncTag = std::uint64_t(1) << 63;
+        std::vector<int> fds(groups.size(), -1);
+        std::vector<std::uint64_t> offsets(batch.size(), 0);
+        std::vector<size_t> groupOf(batch.size(), 0);
+        std::vector<char> seen(batch.size(), 0), synced(groups.size(), 0), patched(groups.size(), 0);
+        size_t fixedWrites = 0;
+        bool alive = true;
+        ring.done.clear();
+
+        // Дождаться отправленного и разобрать завершения
+        auto complete = [&] {
+            alive = ring.finish() && alive;
+            for (const std::pair<std::uint64_t, int>& c : ring.done) {
+                if (c.first & kSyncTag) { synced[c.first & ~kSyncTag] = c.second >= 0; continue; }
+                size_t k = (size_t)c.first;
+                seen[k] = 1;
+                if (c.second < 0) { ok[k] = 0; continue; }
+                // Короткая запись (диск полон, больше kRingMaxWrite) — остаток обычным pwrite
+                const std::vector<unsigned char>& d = batch[k].req.data;
+                size_t written = (size_t)c.second;
+                int fd = fds[groupOf[k]];
+                if (written < d.size()) patched[groupOf[k]] = 1;
+                while (written < d.size()) {
+                    ssize_t n = pwrite(fd, d.data() + written, d.size() - written, (off_t)(offsets[k] + written));
+                    if (n <= 0) { ok[k] = 0; break; }
+                    written += (size_t)n;
+                }
+            }
+            ring.done.clear();
+        };
+
+        for (size_t gi = 0; gi < groups.size(); gi++) {
+            const Group& g = groups[gi];
+            const std::string& path = batch[g.from].req.path;
+            // Файл уже был в пачке — сначала дописываем прежнюю группу
+            // (иначе размер для дозаписи и O_TRUNC обгонят её записи)
+            for (size_t prev = 0; prev < gi; prev++)
+                if (batch[groups[prev].from].req.path == path) { complete(); break; }
+
+            bool append = batch[g.from].req.mode == Mode::Append;
+            int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC), 0644);
+            off_t end = fd >= 0 && append ? lseek(fd, 0, SEEK_END) : 0;
+            if (end < 0) { ::close(fd); fd = -1; }
+            fds[gi] = fd;
+            std::uint64_t offset = (std::uint64_t)end;
+            for (size_t k = g.from; k < g.to; k++) {
+                const std::vector<unsigned char>& d = batch[k].req.data;
+                groupOf[k] = gi;
+                offsets[k] = offset;
+                offset += d.size();
+                if (fd < 0) { ok[k] = 0; continue; }
+                if (d.empty()) continue;
+                ring.write(fd, d.data(), (unsigned)std::min(d.size(), kRingMaxWrite), offsets[k], fixedIndex[k], k);
+                fixedWrites += fixedIndex[k] >= 0;
+            }
+            if (fd >= 0 && g.sync) ring.fsync(fd, kSyncTag | gi);
+        }
+        complete();
+        for (size_t k = 0; k < batch.size(); k++)
+            if (!batch[k].req.data.empty() && !seen[k]) ok[k] = 0; // кольцо не вернуло результат
+
+        size_t syncs = 0, syncErrors = 0;
+        for (size_t gi = 0; gi < groups.size(); gi++) {
+            const Group& g = groups[gi];
+            if (fds[gi] < 0) continue;
+            bool good = true;
+            for (size_t k = g.from; k < g.to; k++) good = good && ok[k];
+            if (g.sync) {
+                // Дописанное мимо кольца fsync из кольца не покрыл
+                bool s = synced[gi] != 0;
+                if (good && s && patched[gi]) s = fsync(fds[gi]) == 0;
+                syncs++;
+                if (!s) syncErrors++;
+                good = good && s;
+            }
+            good = (::close(fds[gi]) == 0) && good;
+            for (size_t k = g.from; k < g.to; k++) ok[k] = good;
+        }
+        if (!fixed.empty()) ring.registerBuffers({});
+
+        std::lock_guard<std::mutex> lock(mtx);
+        stats.fixedWrites += fixedWrites;
+        stats.syncs += syncs;
+        stats.syncErrors += syncErrors;
+        return alive;
+    }
+#endif
+
+    void run() {
+        std::vector<Pending> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                auto ready = [&] { return !queue.empty() || stopping; };
+                Clock::time_point due;
+                if (nextSyncDue(due)) cv.wait_until(lock, due, ready);
+                else cv.wait(lock, ready);
+                if (queue.empty()) {
+                    bool exit = stopping;
+                    lock.unlock();
+                    syncDue(exit);
+                    if (exit) return;
+                    continue;
+                }
+                batch.swap(queue);
+                writing = true;
+            }
+
+            std::vector<char> ok(batch.size(), 1);
+            std::vector<Group> groups = groupBatch(batch, Clock::now());
+            bool written = false;
+#if defined(SAPPER_IO_URING)
+            if (ring.ready()) {
+                written = true;
+                if (!writeRing(batch, groups, ok)) {
+                    ring.close(); // следующие пачки — через stdio
+                    std::lock_guard<std::mutex> lock(mtx);
+                    stats.backend = Backend::Threads;
+                }
+            }
+#endif
+            if (!written) writeStdio(batch, groups, ok);
+            syncDue(false);
+
+            auto now = Clock::now();
+            for (size_t k = 0; k < batch.size(); k++) {
+                Pending& p = batch[k];
+                if (p.req.done) p.req.done(ok[k] != 0);
+                std::lock_guard<std::mutex> lock(mtx);
+                double ms = std::chrono::duration<double, std::milli>(now - p.queued).count();
+                latencySumMs += ms;
+                stats.maxLatencyMs = std::max(stats.maxLatencyMs, ms);
+                stats.completed++;
+                if (!ok[k]) stats.failed++;
+                stats.bytes += p.req.data.size();
+                if (pool.size() < 16 && p.req.data.capacity() > 0) pool.push_back(std::move(p.req.data));
+            }
+            batch.clear();
+
+            std::lock_guard<std::mutex> lock(mtx);
+            stats.batches++;
+            writing = false;
+            cv.notify_all();
+        }
+    }
+};
+
+// OPENING TABLE — статистика первых ходов для пресета.
+// Для каждой клетки: сколько партий сыграно, выиграно, и сколько клеток
+// в сумме открыл первый клик. Хранится в кэше openings_WxHxM.txt.
+
+struct OpeningTable {
+    int W = 0, H = 0, MINES = 0;
+    std::vector<std::uint64_t> games, wins, openedSum;
+
+    void reset(int w, int h, int m) {
+        W = w; H = h; MINES = m;
+        games.assign((size_t)w * h, 0);
+        wins.assign((size_t)w * h, 0);
+        openedSum.assign((size_t)w * h, 0);
+    }
+
+    bool matches(int w, int h, int m) const { return W == w && H == h && MINES == m; }
+
+    size_t bytes() const { return vectorBytes(games) + vectorBytes(wins) + vectorBytes(openedSum); }
+
+    double winRate(int i) const { return games[i] ? (double)wins[i] / (double)games[i] : 0.0; }
+    double expectedOpening(int i) const { return games[i] ? (double)openedSum[i] / (double)games[i] : 0.0; }
+
+    // Лучшая клетка: максимум вероятности победы, при равенстве — больший раскрой
+    int bestCell() const {
+        int best = -1;
+        for (int i = 0; i < W * H; i++) {
+            if (!games[i]) continue;
+            if (best < 0 || winRate(i) > winRate(best)
+                || (winRate(i) == winRate(best) && expectedOpening(i) > expectedOpening(best)))
+                best = i;
+        }
+        return best;
+    }
+
+    static std::string cachePath(int w, int h, int m) {
+        return "openings_" + std::to_string(w) + "x" + std::to_string(h) + "x" + std::to_string(m) + ".txt";
+    }
+
+    bool save(const std::string& path) const {
+        std::string text = std::to_string(W) + " " + std::to_string(H) + " " + std::to_string(MINES) + "\n";
+        for (int i = 0; i < W * H; i++)
+            text += std::to_string(games[i]) + " " + std::to_string(wins[i]) + " "
+                  + std::to_string(openedSum[i]) + "\n";
+
+        AsyncIoService::Request r;
+        r.path = path;
+        r.data.assign(text.begin(), text.end());
+        r.mode = AsyncIoService::Mode::Truncate;
+        r.fsync = AsyncIoService::Fsync::Always;
+        return AsyncIoService::instance().submitAndWait(std::move(r));
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream f(path);
+        int w, h, m;
+        if (!(f >> w >> h >> m) || w <= 0 || h <= 0) return false;
+        reset(w, h, m);
+        for (int i = 0; i < w * h; i++)
+            if (!(f >> games[i] >> wins[i] >> openedSum[i])) { reset(0, 0, 0); return false; }
+        return true;
+    }
+};
+
+// BOTS — PATTERN: Strategy (автоматический игрок для симулятора)
+
+struct BotMove {
+    int  x = 0, y = 0;
+    bool flag = false;
+};
+
+class IBotPolicy {
+public:
+    virtual ~IBotPolicy() = default;
+    virtual const char* name() const = 0;
+    // Вызывается, пока игра не окончена; false — хода нет (закрытые клетки
+    // кончились: все под флагами)
+    virtual bool nextMove(const Game& game, BotMove& out) = 0;
+};
+
+// Случайная закрытая клетка без флага; interiorOnly — только вдали от фронтира
+static int randomUnknownCell(const Game& g, std::mt19937& rng, bool interiorOnly) {
+    auto fits = [&](int i) {
+        const ICellState& s = *g.field[i / g.W][i % g.W].state;
+        return !s.isOpen() && !s.isFlagged() && !(interiorOnly && g.frontierClosed.contains(i));
+    };
+    for (int attempt = 0; attempt < 64; attempt++) {
+        int i = (int)(rng() % (unsigned)(g.W * g.H));
+        if (fits(i)) return i;
+    }
+    for (int i = 0; i < g.W * g.H; i++)
+        if (fits(i)) return i;
+    return -1;
+}
+
+// Бот на решателе: гарантированные ходы, иначе — клетка с наименьшей
+// вероятностью мины (по точному перебору фронтира).
+class SolverBot final : public IBotPolicy {
+    DefaultSolver solver;
+    ExactFrontierSolver exact;
+    std::vector<Deduction> scratch;
+    std::vector<CellOdds>  odds;
+    std::mt19937 rng;
+    const OpeningTable* openings;
+
+public:
+    explicit SolverBot(std::uint32_t seed = 1, const OpeningTable* table = nullptr)
+        : rng(seed), openings(table) {}
+
+    const char* name() const override { return openings ? "solver-openings" : "solver"; }
+
+    bool nextMove(const Game& g, BotMove& out) override {
+        if (g.firstClick) { out = firstClick(g); return true; }
+        Deduction d;
+        if (solver.nextMove(g, d)) { out = {d.x, d.y, d.mine}; return true; }
+        return guess(g, out);
+    }
+
+private:
+    BotMove firstClick(const Game& g) const {
+        if (openings && openings->matches(g.W, g.H, g.MINES)) {
+            int best = openings->bestCell();
+            if (best >= 0) return {best % g.W, best / g.W, false};
+        }
+        return {g.W / 2, g.H / 2, false};
+    }
+
+    bool guess(const Game& g, BotMove& out) {
+        scratch.clear();
+        odds.clear();
+        exact.analyze(g, scratch, &odds);
+
+        // Мины, не объяснённые фронтиром, считаем равномерно рассыпанными
+        int unknownTotal = g.W * g.H - g.openedCount - g.flagCount;
+        float frontierMines = 0.0f;
+        for (const CellOdds& o : odds) frontierMines += o.pMine;
+        int rest = unknownTotal - (int)odds.size();
+        float restDensity = rest > 0 ? (g.MINES - g.flagCount - frontierMines) / rest : 1.0f;
+
+        const CellOdds* best = nullptr;
+        for (const CellOdds& o : odds)
+            if (!best || o.pMine < best->pMine) best = &o;
+
+        if (best && (best->pMine <= restDensity || rest <= 0)) { out = {best->x, best->y, false}; return true; }
+
+        int i = randomUnknownCell(g, rng, (int)g.frontierClosed.size() < unknownTotal);
+        if (i < 0 && best) { out = {best->x, best->y, false}; return true; }
+        if (i < 0) return false;
+        out = {i % g.W, i / g.W, false};
+        return true;
+    }
+};
+
+// Бот без вероятностей: гарантированные ходы решателя, иначе — наугад
+class RandomGuessBot final : public IBotPolicy {
+    DefaultSolver solver;
+    std::mt19937 rng;
+public:
+    explicit RandomGuessBot(std::uint32_t seed = 1) : rng(seed) {}
+
+    const char* name() const override { return "random-guess"; }
+
+    bool nextMove(const Game& g, BotMove& out) override {
+        if (g.firstClick) { out = {g.W / 2, g.H / 2, false}; return true; }
+        Deduction d;
+        if (solver.nextMove(g, d)) { out = {d.x, d.y, d.mine}; return true; }
+        int i = randomUnknownCell(g, rng, false);
+        if (i < 0) return false;
+        out = {i % g.W, i / g.W, false};
+        return true;
+    }
+};
+
+// Видимое поле Game (VisibleCode) — по объектам клеток
+static void encodeVisible(const Game& g, std::vector<unsigned char>& out) {
+    out.resize((size_t)g.W * g.H);
+    for (int y = 0; y < g.H; y++)
+        for (int x = 0; x < g.W; x++)
+            out[g.index(x, y)] = visibleCode(g.field[y][x]);
+}
+
+// NEURAL EVALUATOR — маленькая свёрточная сеть на CPU (свёртки 3x3, fp32).
+// Вход: one-hot кода клетки (0..8, закрыто, флаг) + канал "клетка на поле".
+// Скрытые слои — ReLU, последний слой (1 канал) — сигмоида = вероятность мины.
+//
+// Формат файла весов (little-endian): "MSNN", int32 число слоёв, далее для
+// каждого слоя int32 inC, int32 outC, float w[outC][inC][3][3], float b[outC].
+//
+// Пакет досок складывается в одну высокую картинку: доски друг под другом,
+// между ними строка нулей. Тогда свёртка пакета — это одна свёртка картинки,
+// и каждый вес загружается один раз на весь пакет.
+
+struct NeuralModel {
+    static constexpr int kInputChannels = 12;
+
+    struct Layer {
+        int inC = 0, outC = 0;
+        std::vector<float> w, b;
+    };
+    std::vector<Layer> layers;
+
+    bool load(const std::string& path) {
+        std::ifstream f(path, std::ios::binary);
+        char magic[4];
+        std::int32_t count = 0;
+        if (!f.read(magic, 4) || std::string(magic, 4) != "MSNN") return false;
+        if (!f.read((char*)&count, 4) || count <= 0 || count > 64) return false;
+
+        std::vector<Layer> loaded(count);
+        int prevOut = kInputChannels;
+        for (Layer& l : loaded) {
+            std::int32_t io[2];
+            if (!f.read((char*)io, 8) || io[0] != prevOut || io[1] <= 0 || io[1] > 256) return false;
+            l.inC = io[0]; l.outC = io[1];
+            l.w.resize((size_t)l.outC * l.inC * 9);
+            l.b.resize(l.outC);
+            if (!f.read((char*)l.w.data(), l.w.size() * sizeof(float))) return false;
+            if (!f.read((char*)l.b.data(), l.b.size() * sizeof(float))) return false;
+            prevOut = l.outC;
+        }
+        if (prevOut != 1) return false;
+        layers.swap(loaded);
+        return true;
+    }
+
+    // Случайные веса — для замеров скорости без файла
+    void randomize(int hidden, int depth, std::uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::normal_distribution<float> nd(0.0f, 0.2f);
+        layers.clear();
+        int in = kInputChannels;
+        for (int d = 0; d < depth; d++) {
+            Layer l;
+            l.inC = in; l.outC = d + 1 == depth ? 1 : hidden;
+            l.w.resize((size_t)l.outC * l.inC * 9);
+            for (float& v : l.w) v = nd(rng);
+            l.b.assign(l.outC, 0.0f);
+            layers.push_back(l);
+            in = l.outC;
+        }
+    }
+};
+
+// dst[i] += k * src[i] — внутренний цикл свёртки
+static inline void axpyRow(float* dst, const float* src, float k, int n) {
+    int i = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 kv = _mm256_set1_ps(k);
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(kv, _mm256_loadu_ps(src + i), _mm256_loadu_ps(dst + i)));
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128 kv = _mm_set1_ps(k);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(kv, _mm_loadu_ps(src + i))));
+#endif
+    for (; i < n; i++) dst[i] += k * src[i];
+}
+
+class NeuralEvaluator {
+    const NeuralModel& model;
+    int W = 0, H = 0, B = 0;   // размеры доски и пакета
+    int PW = 0, PH = 0;        // размеры сложенной картинки с рамкой
+    std::vector<float> bufA, bufB;
+    std::vector<float> mask;   // 1 — клетка доски, 0 — рамка
+
+    size_t plane() const { return (size_t)PW * PH; }
+
+    // Каждый отвод ядра 3x3 — длинный axpy по картинке (строки идут подряд,
+    // рамка шириной 1 не даёт доскам "перетекать"); значения, попавшие
+    // в рамку, потом обнуляются маской. Картинка обрабатывается кусками,
+    // чтобы кусок выхода оставался в L1 на все входные каналы.
+    void conv(const NeuralModel::Layer& l, const float* in, float* out, bool relu) {
+        const size_t P = plane();
+        const size_t lo = (size_t)PW + 1, hi = P - lo;
+        const size_t kChunk = 512;
+
+        std::fill(out, out + (size_t)l.outC * P, 0.0f);
+        for (size_t c0 = lo; c0 < hi; c0 += kChunk) {
+            const int n = (int)std::min(kChunk, hi - c0);
+            for (int oc = 0; oc < l.outC; oc++) {
+                float* o = out + oc * P + c0;
+                std::fill(o, o + n, l.b[oc]);
+                for (int ic = 0; ic < l.inC; ic++) {
+                    const float* src = in + ic * P + c0;
+                    const float* k = &l.w[((size_t)oc * l.inC + ic) * 9];
+                    for (int ky = 0; ky < 3; ky++)
+                        for (int kx = 0; kx < 3; kx++)
+                            axpyRow(o, src + (ky - 1) * PW + (kx - 1), k[ky * 3 + kx], n);
+                }
+                const float* m = mask.data() + c0;
+                for (int i = 0; i < n; i++)
+                    o[i] = (relu ? std::max(o[i], 0.0f) : o[i]) * m[i];
+            }
+        }
+    }
+
+public:
+    explicit NeuralEvaluator(const NeuralModel& m) : model(m) {}
+
+    // Вероятность мины для каждой клетки каждой доски пакета (доски одного размера)
+    void evaluate(const std::vector<const Game*>& boards, std::vector<std::vector<float>>& pMine) {
+        if (boards.empty() || model.layers.empty()) return;
+        W = boards[0]->W; H = boards[0]->H; B = (int)boards.size();
+        PW = W + 2; PH = B * (H + 1) + 1;
+
+        size_t maxC = NeuralModel::kInputChannels;
+        for (const NeuralModel::Layer& l : model.layers) maxC = std::max(maxC, (size_t)l.outC);
+        bufA.assign(maxC * plane(), 0.0f);
+        bufB.assign(maxC * plane(), 0.0f);
+        mask.assign(plane(), 0.0f);
+
+        std::vector<unsigned char> vis;
+        for (int b = 0; b < B; b++) {
+            encodeVisible(*boards[b], vis);
+            for (int y = 0; y < H; y++)
+                for (int x = 0; x < W; x++) {
+                    size_t at = (size_t)(b * (H + 1) + 1 + y) * PW + 1 + x;
+                    unsigned char v = vis[y * W + x];
+                    if (v <= VisFlag) bufA[v * plane() + at] = 1.0f;
+                    bufA[(NeuralModel::kInputChannels - 1) * plane() + at] = 1.0f;
+                    mask[at] = 1.0f;
+                }
+        }
+
+        float* in = bufA.data();
+        float* out = bufB.data();
+        for (size_t i = 0; i < model.layers.size(); i++) {
+            conv(model.layers[i], in, out, i + 1 < model.layers.size());
+            std::swap(in, out);
+        }
+
+        pMine.resize(B);
+        for (int b = 0; b < B; b++) {
+            pMine[b].resize((size_t)W * H);
+            for (int y = 0; y < H; y++)
+                for (int x = 0; x < W; x++) {
+                    float z = in[(size_t)(b * (H + 1) + 1 + y) * PW + 1 + x];
+                    pMine[b][y * W + x] = 1.0f / (1.0f + std::exp(-z));
+                }
+        }
+    }
+};
+
+// Общая модель для ботов: грузится один раз из evaluator.nn
+static const NeuralModel* sharedNeuralModel() {
+    static NeuralModel model;
+    static bool ok = model.load("evaluator.nn");
+    return ok ? &model : nullptr;
+}
+
+// Бот с нейросетью: гарантированные ходы решателя, иначе — самая
+// безопасная по мнению сети закрытая клетка
+class NeuralBot final : public IBotPolicy {
+    DefaultSolver solver;
+    NeuralEvaluator evaluator;
+    std::vector<std::vector<float>> pMine;
+public:
+    explicit NeuralBot(const NeuralModel& m) : evaluator(m) {}
+
+    const char* name() const override { return "neural"; }
+
+    bool nextMove(const Game& g, BotMove& out) override {
+        if (g.firstClick) { out = {g.W / 2, g.H / 2, false}; return true; }
+        Deduction d;
+        if (solver.nextMove(g, d)) { out = {d.x, d.y, d.mine}; return true; }
+
+        evaluator.evaluate({&g}, pMine);
+        int best = -1;
+        for (int i = 0; i < g.W * g.H; i++) {
+            const ICellState& s = *g.field[i / g.W][i % g.W].state;
+            if (s.isOpen() || s.isFlagged()) continue;
+            if (best < 0 || pMine[0][i] < pMine[0][best]) best = i;
+        }
+        if (best < 0) return false;
+        out = {best % g.W, best / g.W, false};
+        return true;
+    }
+};
+
+// Factory: бот по имени (для симулятора и турниров); nullptr — неизвестное имя
+static std::unique_ptr<IBotPolicy> makeBotPolicy(const std::string& name, std::uint32_t seed,
+                                                 const OpeningTable* openings = nullptr)
+{
+    if (name == "solver")          return std::make_unique<SolverBot>(seed);
+    if (name == "solver-openings") return std::make_unique<SolverBot>(seed, openings);
+    if (name == "random-guess")    return std::make_unique<RandomGuessBot>(seed);
+    if (name == "neural" && sharedNeuralModel()) return std::make_unique<NeuralBot>(*sharedNeuralModel());
+    return nullptr;
+}
+
+// SIMULATOR (headless) — партия бота без окна
+
+struct GameOutcome {
+    bool win = false;
+    int  openingSize = 0; // сколько клеток открыл первый клик
+    int  moves = 0;
+};
+
+// PATTERN Observer: симулятор сообщает о каждом ходе бота (запись датасета)
+class ISimObserver {
+public:
+    virtual ~ISimObserver() = default;
+    // Вызывается перед ходом, когда поле уже сгенерировано
+    virtual void beforeMove(const Game& game, const BotMove& move) = 0;
+};
+
+// firstX/firstY >= 0 — принудительный первый клик (для анализа дебютов)
+static GameOutcome playGame(Game& game, IBotPolicy& bot, std::uint32_t seed,
+                            int firstX = -1, int firstY = -1, ISimObserver* observer = nullptr)
+{
+    game.boardGenerator->reseed(seed);
+    game.resetField();
+
+    GameOutcome r;
+    const int moveLimit = game.W * game.H * 4; // защита от зацикливания бота
+    while (!game.gameOver && !game.win && r.moves < moveLimit) {
+        bool first = game.firstClick;
+        BotMove m{firstX, firstY, false};
+        if (!(first && firstX >= 0) && !bot.nextMove(game, m)) break; // ходить некуда — партия не выиграна
+        if (observer && !first) observer->beforeMove(game, m);
+        if (m.flag) game.rightClickCell(m.x, m.y);
+        else        game.leftClickCell(m.x, m.y);
+        if (first) r.openingSize = game.openedCount;
+        r.moves++;
+    }
+    r.win = game.win;
+    return r;
+}
+
+// OPENING ANALYZER — офлайн-анализ первых кликов.
+// Клетки, симметричные друг другу, считаются один раз. Симуляция идёт
+// раундами ("гонка"): клетка выбывает, когда доверительный интервал
+// вероятности победы стал уже halfWidth, или когда её верхняя граница
+// ниже нижней границы лучшей клетки (дальше считать бессмысленно).
+
+class OpeningAnalyzer {
+public:
+    struct Options {
+        int           batch = 256;              // партий на клетку за раунд
+        std::uint64_t maxGamesPerCell = 200000;
+        double        halfWidth = 0.01;         // целевая точность (95%)
+    };
+
+    struct Report {
+        std::uint64_t gamesPlayed = 0;
+        std::uint64_t gamesFixedSize = 0; // сколько было бы без остановки
+    };
+
+    static Report run(const GamePreset& p, const Options& opt, OpeningTable& table) {
+        table.reset(p.W, p.H, p.MINES);
+        Report rep;
+
+        // Представители классов симметрии
+        std::vector<int> reps, repOf(p.W * p.H);
+        for (int y = 0; y < p.H; y++)
+            for (int x = 0; x < p.W; x++) {
+                int c = canonical(p, x, y);
+                repOf[y * p.W + x] = c;
+                if (c == y * p.W + x) reps.push_back(c);
+            }
+        rep.gamesFixedSize = opt.maxGamesPerCell * reps.size();
+
+        // По игре на каждый рабочий поток; создаётся в самом потоке
+        // (первое касание — память на узле NUMA его ядра)
+        std::vector<std::unique_ptr<Game>> games(workerCount());
+
+        const int chunk = 32; // партий в одной задаче
+        std::vector<int> active = reps;
+        while (!active.empty()) {
+            int perCell = (opt.batch + chunk - 1) / chunk;
+            int tasks = (int)active.size() * perCell;
+            std::vector<Tally> sums(tasks);
+
+            parallelFor(tasks, [&](int t, int w) {
+                if (!games[w])
+                    games[w] = std::make_unique<Game>(p.W, p.H, p.MINES,
+                        std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+                int cell = active[t / perCell];
+                std::uint64_t base = table.games[cell] + (std::uint64_t)(t % perCell) * chunk;
+                for (int k = 0; k < chunk; k++) {
+                    // Одни и те же зёрна (доски и бота) для всех клеток — меньше разброс
+                    // при сравнении, и таблица не зависит от числа потоков
+                    std::uint32_t seed = mixSeed(base + k);
+                    SolverBot bot(seed);
+                    GameOutcome o = playGame(*games[w], bot, seed, cell % p.W, cell / p.W);
+                    sums[t].games++;
+                    sums[t].wins += o.win ? 1 : 0;
+                    sums[t].opened += (std::uint64_t)o.openingSize;
+                }
+            });
+
+            for (int t = 0; t < tasks; t++) {
+                int cell = active[t / perCell];
+                table.games[cell] += sums[t].games;
+                table.wins[cell] += sums[t].wins;
+                table.openedSum[cell] += sums[t].opened;
+                rep.gamesPlayed += sums[t].games;
+            }
+
+            double bestLow = 0.0;
+            for (int c : active) bestLow = std::max(bestLow, table.winRate(c) - halfWidth(table, c));
+
+            std::vector<int> still;
+            for (int c : active) {
+                double hw = halfWidth(table, c);
+                bool precise = hw < opt.halfWidth;
+                bool beaten = table.winRate(c) + hw < bestLow;
+                bool capped = table.games[c] >= opt.maxGamesPerCell;
+                if (!precise && !beaten && !capped) still.push_back(c);
+            }
+            active.swap(still);
+        }
+
+        // Копируем результат представителей на симметричные клетки
+        for (int i = 0; i < p.W * p.H; i++) {
+            int c = repOf[i];
+            table.games[i] = table.games[c];
+            table.wins[i] = table.wins[c];
+            table.openedSum[i] = table.openedSum[c];
+        }
+        return rep;
+    }
+
+private:
+    struct Tally {
+        std::uint64_t games = 0, wins = 0, opened = 0;
+    };
+
+    static double halfWidth(const OpeningTable& t, int c) {
+        double n = (double)t.games[c];
+        double pr = t.winRate(c);
+        return 1.96 * std::sqrt(std::max(pr * (1.0 - pr), 0.25 / n) / n);
+    }
+
+    // Наименьший индекс среди отражений (и поворота, если поле квадратное)
+    static int canonical(const GamePreset& p, int x, int y) {
+        int best = y * p.W + x;
+        int xs[2] = {x, p.W - 1 - x}, ys[2] = {y, p.H - 1 - y};
+        for (int a : xs)
+            for (int b : ys) {
+                best = std::min(best, b * p.W + a);
+                if (p.W == p.H) best = std::min(best, a * p.W + b);
+            }
+        return best;
+    }
+};
+
+// TOURNAMENT — два бота на одинаковых досках (парное сравнение).
+// Значимы только "несовпавшие" пары, где выиграл ровно один бот. Для них
+// идёт последовательный тест Вальда (SPRT): H0 — доля побед A равна 1/2,
+// H1 — смещена на delta в одну из сторон. Турнир останавливается, как только
+// одна из гипотез принята, а не после фиксированного числа партий.
+
+class Tournament {
+public:
+    struct Options {
+        std::uint64_t maxGames = 100000;
+        double delta = 0.1;  // различимый перекос среди несовпавших пар
+        double alpha = 0.05; // ошибка I рода
+        double beta  = 0.05; // ошибка II рода
+        int    batch = 256;  // партий за раунд (параллельно)
+    };
+
+    enum class Verdict { Undecided, ABetter, BBetter, NoDifference };
+
+    struct Report {
+        std::uint64_t games = 0;
+        std::uint64_t winsA = 0, winsB = 0;
+        std::uint64_t onlyA = 0, onlyB = 0;  // несовпавшие пары
+        Verdict verdict = Verdict::Undecided;
+        double diff = 0.0, ciLow = 0.0, ciHigh = 0.0; // winRate(A) - winRate(B), 95%
+        double seconds = 0.0, secondsSaved = 0.0;     // оценка по средней цене партии
+    };
+
+    static Report run(const GamePreset& p, const std::string& nameA, const std::string& nameB,
+                      const Options& opt, const OpeningTable* openings = nullptr)
+    {
+        const double upper = std::log((1.0 - opt.beta) / opt.alpha);
+        const double lower = std::log(opt.beta / (1.0 - opt.alpha));
+        const double up   = std::log((0.5 + opt.delta) / 0.5);
+        const double down = std::log((0.5 - opt.delta) / 0.5);
+
+        struct Worker {
+            std::unique_ptr<Game> game; // создаётся в своём потоке (первое касание)
+        };
+        std::vector<Worker> workers(workerCount());
+
+        Report rep;
+        sf::Clock clock;
+        double llrUp = 0.0, llrDown = 0.0; // A лучше / B лучше против H0
+
+        while (rep.verdict == Verdict::Undecided && rep.games < opt.maxGames) {
+            int n = (int)std::min<std::uint64_t>(opt.batch, opt.maxGames - rep.games);
+            std::vector<std::array<bool, 2>> results(n);
+
+            parallelFor(n, [&](int i, int w) {
+                if (!workers[w].game)
+                    workers[w].game = std::make_unique<Game>(p.W, p.H, p.MINES,
+                        std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+                std::uint64_t gameNo = rep.games + (std::uint64_t)i;
+                std::uint32_t seed = mixSeed(gameNo);
+                // Одна и та же доска и одно и то же зерно бота для обоих
+                std::unique_ptr<IBotPolicy> a = makeBotPolicy(nameA, seed, openings);
+                std::unique_ptr<IBotPolicy> b = makeBotPolicy(nameB, seed, openings);
+                results[i][0] = playGame(*workers[w].game, *a, seed).win;
+                results[i][1] = playGame(*workers[w].game, *b, seed).win;
+            });
+
+            // Проверяем тест по порядку партий: результат не зависит от числа потоков
+            for (int i = 0; i < n && rep.verdict == Verdict::Undecided; i++) {
+                rep.games++;
+                rep.winsA += results[i][0];
+                rep.winsB += results[i][1];
+                if (results[i][0] == results[i][1]) continue;
+
+                if (results[i][0]) { rep.onlyA++; llrUp += up;   llrDown += down; }
+                else               { rep.onlyB++; llrUp += down; llrDown += up;   }
+
+                if (llrUp >= upper)        rep.verdict = Verdict::ABetter;
+                else if (llrDown >= upper) rep.verdict = Verdict::BBetter;
+                else if (llrUp <= lower && llrDown <= lower) rep.verdict = Verdict::NoDifference;
+            }
+        }
+
+        // Парная разность: d_i = winA_i - winB_i принимает значения -1, 0, 1
+        double g = (double)rep.games;
+        rep.diff = ((double)rep.onlyA - (double)rep.onlyB) / g;
+        double var = ((double)(rep.onlyA + rep.onlyB) / g - rep.diff * rep.diff) / g;
+        double hw = 1.96 * std::sqrt(std::max(var, 0.0));
+        rep.ciLow = rep.diff - hw;
+        rep.ciHigh = rep.diff + hw;
+
+        rep.seconds = clock.getElapsedTime().asSeconds();
+        rep.secondsSaved = rep.seconds / g * (double)(opt.maxGames - rep.games);
+        return rep;
+    }
+
+    static const char* verdictName(Verdict v) {
+        switch (v) {
+            case Verdict::ABetter:      return "A is stronger";
+            case Verdict::BBetter:      return "B is stronger";
+            case Verdict::NoDifference: return "no difference larger than delta";
+            default:                    return "undecided (game limit reached)";
+        }
+    }
+};
+
+// DATASET EXPORT — позиции из партий ботов для обучения оценщика.
+// Шард: заголовок DatasetShardHeader и recordCount записей фиксированного
+// размера. Запись одной позиции (W*H клеток):
+//   наблюдение — код encodeVisible, 4 бита на клетку;
+//   метка      — мина/не мина, 1 бит на клетку;
+//   аннотация  — вывод решателя: 0 неизвестно, 1 безопасно, 2 мина, 2 бита.
+
+struct DatasetShardHeader {
+    char          magic[4] = {'M', 'S', 'D', 'S'};
+    std::uint32_t version = 1;
+    std::uint32_t W = 0, H = 0;
+    std::uint32_t recordBytes = 0;
+    std::uint32_t recordCount = 0;
+};
+
+struct DatasetLayout {
+    size_t cells = 0, obsBytes = 0, labelBytes = 0, annBytes = 0;
+
+    DatasetLayout(int w, int h)
+        : cells((size_t)w * h), obsBytes((cells + 1) / 2),
+          labelBytes((cells + 7) / 8), annBytes((cells + 3) / 4) {}
+
+    size_t recordBytes() const { return obsBytes + labelBytes + annBytes; }
+};
+
+// Двойная буферизация: поток симуляции заполняет один буфер, пока второй
+// пишет AsyncIoService. Симуляция ждёт, только если диск не успевает.
+// Буфер шарда начинается с места под заголовок.
+class ShardWriter {
+    std::string prefix;
+    DatasetShardHeader header;
+    size_t recordsPerShard;
+
+    std::vector<unsigned char> front;   // заполняется
+    size_t frontRecords = 0;
+    int shardNo = 0;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    int inFlight = 0;                   // шардов в очереди записи (не больше одного)
+    std::uint64_t bytesWritten = 0;
+    bool failed = false;
+
+    void newFront() {
+        front = AsyncIoService::instance().takeBuffer();
+        front.resize(sizeof(DatasetShardHeader) + recordsPerShard * header.recordBytes);
+        frontRecords = 0;
+    }
+
+    void handOff() {
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return inFlight == 0; });
+            inFlight++;
+        }
+        DatasetShardHeader h = header;
+        h.recordCount = (std::uint32_t)frontRecords;
+        std::memcpy(front.data(), &h, sizeof(h));
+        front.resize(sizeof(h) + frontRecords * header.recordBytes);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "-%05d.msds", shardNo++);
+        AsyncIoService::Request r;
+        r.path = prefix + name;
+        r.mode = AsyncIoService::Mode::Truncate;
+        r.data = std::move(front);
+        size_t bytes = r.data.size();
+        r.done = [this, bytes](bool ok) {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!ok) failed = true;
+            bytesWritten += bytes;
+            inFlight--;
+            cv.notify_all();
+        };
+        AsyncIoService::instance().submit(std::move(r));
+        newFront();
+    }
+
+public:
+    ShardWriter(const std::string& filePrefix, int w, int h, size_t shardBytes)
+        : prefix(filePrefix)
+    {
+        header.W = (std::uint32_t)w;
+        header.H = (std::uint32_t)h;
+        header.recordBytes = (std::uint32_t)DatasetLayout(w, h).recordBytes();
+        recordsPerShard = std::max<size_t>(1, shardBytes / header.recordBytes);
+        newFront();
+    }
+
+    ~ShardWriter() { close(); }
+
+    // Место под следующую запись (заполняется вызывающим)
+    unsigned char* nextRecord() {
+        if (frontRecords == recordsPerShard) handOff();
+        return front.data() + sizeof(DatasetShardHeader) + (frontRecords++) * header.recordBytes;
+    }
+
+    void close() {
+        if (frontRecords) handOff();
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return inFlight == 0; });
+    }
+
+    std::uint64_t written() const { return bytesWritten; }
+    bool ok() const { return !failed; }
+};
+
+class DatasetRecorder final : public ISimObserver {
+    DatasetLayout layout;
+    ShardWriter& writer;
+    ExactFrontierSolver exact;
+    std::vector<Deduction> deductions;
+    std::vector<unsigned char> vis;
+public:
+    std::uint64_t records = 0;
+
+    DatasetRecorder(int w, int h, ShardWriter& out) : layout(w, h), writer(out) {}
+
+    void beforeMove(const Game& g, const BotMove&) override {
+        unsigned char* rec = writer.nextRecord();
+        std::fill(rec, rec + layout.recordBytes(), 0);
+        unsigned char* obs = rec;
+        unsigned char* label = obs + layout.obsBytes;
+        unsigned char* ann = label + layout.labelBytes;
+
+        encodeVisible(g, vis);
+        for (size_t i = 0; i < layout.cells; i++) {
+            obs[i / 2] |= (unsigned char)(vis[i] << ((i % 2) * 4));
+            if (g.field[i / g.W][i % g.W].content->isMine()) label[i / 8] |= (unsigned char)(1u << (i % 8));
+        }
+
+        deductions.clear();
+        exact.analyze(g, deductions);
+        for (const Deduction& d : deductions) {
+            size_t i = (size_t)g.index(d.x, d.y);
+            ann[i / 4] |= (unsigned char)((d.mine ? 2u : 1u) << ((i % 4) * 2));
+        }
+        records++;
+    }
+};
+
+// REPLAYS — зерно доски и действия игрока со временем.
+// Одна строка файла — один повтор:
+//   W H MINES target3bv seed win time count  kind x y t  kind x y t ...
+// kind: L — открыть, R — флаг, H/G — то же, но по подсказке решателя.
+// t — секунды от начала партии (сброса поля).
+
+struct ReplayAction {
+    char  kind = 'L';
+    int   x = 0, y = 0;
+    float t = 0.0f;
+
+    bool reveal() const { return kind == 'L' || kind == 'H'; }
+    bool hinted() const { return kind == 'H' || kind == 'G'; }
+};
+
+struct Replay {
+    GamePreset    preset;
+    int           target3bv = 0;
+    std::uint32_t seed = 0;
+    bool          claimedWin = false;
+    float         claimedTime = 0.0f;
+    std::vector<ReplayAction> actions;
+
+    std::string toLine() const {
+        std::string line;
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "%d %d %d %d %u %d %.3f %zu",
+                      preset.W, preset.H, preset.MINES, target3bv, (unsigned)seed,
+                      claimedWin ? 1 : 0, claimedTime, actions.size());
+        line += buf;
+        for (const ReplayAction& a : actions) {
+            std::snprintf(buf, sizeof(buf), " %c %d %d %.3f", a.kind, a.x, a.y, a.t);
+            line += buf;
+        }
+        return line;
+    }
+
+    // Разбор строки [p, end); false — строка повреждена
+    bool parse(const char* p, const char* end) {
+        std::string line(p, end); // strtol требует завершающий ноль
+        const char* c = line.c_str();
+        char* next = nullptr;
+        auto num = [&](long& out) {
+            out = std::strtol(c, &next, 10);
+            if (next == c) return false;
+            c = next;
+            return true;
+        };
+        // Зерно — uint32: long на Windows 32-битный, поэтому отдельно и без знака
+        auto seedNum = [&](unsigned long long& out) {
+            while (*c == ' ') c++;
+            if (*c < '0' || *c > '9') return false;
+            out = std::strtoull(c, &next, 10);
+            c = next;
+            return out <= 0xFFFFFFFFull;
+        };
+        auto real = [&](float& out) {
+            out = std::strtof(c, &next);
+            if (next == c) return false;
+            c = next;
+            return true;
+        };
+
+        long w, h, m, tgt, win, count;
+        unsigned long long sd;
+        if (!num(w) || !num(h) || !num(m) || !num(tgt) || !seedNum(sd) || !num(win)) return false;
+        if (!real(claimedTime) || !num(count)) return false;
+        // Строки приходят извне: мин столько, чтобы 3x3 первого клика осталось
+        // свободным (иначе генератор не закончит), 3BV — не больше безопасных
+        // клеток и только при минах, действий — не больше, чем влезает в строку
+        // (каждое не короче " L 0 0 0", 7+ символов)
+        if (w <= 0 || h <= 0 || w > 4096 || h > 4096 || m < 0 || m > w * h - 9) return false;
+        if (tgt < 0 || tgt > w * h - m || (tgt > 0 && m == 0)) return false;
+        if (count < 0 || count > (long)(line.c_str() + line.size() - c) / 7) return false;
+        preset = {(int)w, (int)h, (int)m};
+        target3bv = (int)tgt;
+        seed = (std::uint32_t)sd;
+        claimedWin = win != 0;
+
+        actions.resize((size_t)count);
+        for (ReplayAction& a : actions) {
+            while (*c == ' ') c++;
+            a.kind = *c ? *c++ : 0;
+            long x, y;
+            if (!num(x) || !num(y) || !real(a.t)) return false;
+            a.x = (int)x; a.y = (int)y;
+        }
+        return true;
+    }
+};
+
+// REPLAY VALIDATOR — пересчёт повтора на headless-движке.
+// Проверяет: допустимость действий (в пределах поля, время не идёт назад,
+// нет ходов после конца партии), итог и время; отмечает подсказки
+// и "нечеловеческий" ввод.
+
+class ReplayValidator {
+public:
+    enum Flags : unsigned {
+        Corrupt        = 1u << 0,
+        IllegalAction  = 1u << 1,
+        ResultMismatch = 1u << 2,
+        TimeMismatch   = 1u << 3,
+        Superhuman     = 1u << 4,
+        Assisted       = 1u << 5,
+        Oversized      = 1u << 6  // не пересчитывается: доска или отжиг слишком дороги
+    };
+
+    static constexpr float kTimeTolerance = 0.25f;  // кадр и округление
+    static constexpr float kMinHumanGap   = 0.04f;  // быстрее — подозрительно
+    static constexpr int   kFastStreak    = 5;      // столько таких подряд
+    static constexpr float kMaxHumanRate  = 15.0f;  // действий в секунду в среднем
+
+    // Повторы приходят извне, а пересчёт идёт на Game (объекты на клетку,
+    // ~100 байт) и для target3bv — с отжигом до 200000 шагов на доску.
+    // Окно пишет повторы самое большее 20x20; пределы — с запасом.
+    // Достижимую цель 3BV отжиг находит за несколько тысяч шагов (до 32x32),
+    // дальше идёт недостижимая — её повтор не пересчитываем.
+    static constexpr int    kMaxCells       = 128 * 128;
+    static constexpr int    kMaxAnnealCells = 32 * 32;
+    static constexpr int    kAnnealSteps    = 20000;
+    static constexpr size_t kCacheBytes     = (size_t)32 << 20; // игры одного потока
+
+    struct Result {
+        unsigned flags = 0;
+        int      badAction = -1; // номер первого недопустимого действия
+        bool     win = false;
+        float    time = 0.0f;
+    };
+
+    static bool cheated(unsigned f) { return (f & ~(unsigned)Assisted) != 0; }
+
+    // Игры для пересчёта, по одной на размер и генератор (у каждого потока свой).
+    // Предел — в байтах: старые игры уходят, пока новая не поместится
+    class GameCache {
+        struct Entry { GamePreset p; int target3bv; std::unique_ptr<Game> game; size_t bytes; };
+        std::vector<Entry> entries;
+        size_t total = 0;
+    public:
+        Game& get(const GamePreset& p, int target3bv) {
+            for (Entry& e : entries)
+                if (e.p.W == p.W && e.p.H == p.H && e.p.MINES == p.MINES && e.target3bv == target3bv)
+                    return *e.game;
+            std::unique_ptr<IBoardGenerator> gen = target3bv > 0
+                ? std::make_unique<TargetBbbvBoardGenerator>(target3bv, kAnnealSteps) : makeBoardGenerator(0);
+            auto game = std::make_unique<Game>(p.W, p.H, p.MINES, std::make_unique<DefaultCellFactory>(), std::move(gen));
+            size_t bytes = game->memoryUsage().live;
+            while (!entries.empty() && total + bytes > kCacheBytes) {
+                total -= entries.front().bytes;
+                entries.erase(entries.begin());
+            }
+            total += bytes;
+            entries.push_back({p, target3bv, std::move(game), bytes});
+            return *entries.back().game;
+        }
+        size_t bytes() const { return total; }
+    };
+
+    static Result validate(const Replay& r, GameCache& cache) {
+        Result res;
+        const GamePreset& p = r.preset;
+        if (p.W * p.H > kMaxCells || (r.target3bv > 0 && p.W * p.H > kMaxAnnealCells)) {
+            res.flags |= Oversized;
+            return res;
+        }
+        Game* game = &cache.get(p, r.target3bv);
+        game->boardGenerator->reseed(r.seed);
+        game->resetField();
+
+        float prevT = 0.0f, firstRevealT = -1.0f, endT = 0.0f;
+        int fastStreak = 0;
+        for (size_t i = 0; i < r.actions.size(); i++) {
+            const ReplayAction& a = r.actions[i];
+            bool known = a.kind == 'L' || a.kind == 'R' || a.kind == 'H' || a.kind == 'G';
+            bool legal = known && a.x >= 0 && a.x < p.W && a.y >= 0 && a.y < p.H
+                && a.t >= prevT && !game->gameOver && !game->win;
+            if (!legal) {
+                res.flags |= IllegalAction;
+                res.badAction = (int)i;
+                break;
+            }
+            if (a.hinted()) res.flags |= Assisted;
+
+            fastStreak = (i > 0 && a.t - prevT < kMinHumanGap && !a.hinted()) ? fastStreak + 1 : 0;
+            if (fastStreak >= kFastStreak) res.flags |= Superhuman;
+            prevT = a.t;
+
+            bool first = game->firstClick;
+            if (a.reveal()) game->leftClickCell(a.x, a.y);
+            else            game->rightClickCell(a.x, a.y);
+            if (first && !game->firstClick) {
+                firstRevealT = a.t;
+                // Отжиг не дошёл до цели за kAnnealSteps — доска не та, что в окне
+                if (r.target3bv > 0
+                    && static_cast<TargetBbbvBoardGenerator&>(*game->boardGenerator).bbbv() != r.target3bv) {
+                    res.flags |= Oversized;
+                    return res;
+                }
+            }
+            if (game->gameOver || game->win) endT = a.t;
+        }
+
+        res.win = game->win;
+        res.time = firstRevealT >= 0 && (game->gameOver || game->win) ? endT - firstRevealT : 0.0f;
+
+        if (res.win != r.claimedWin || (!game->win && !game->gameOver)) res.flags |= ResultMismatch;
+        if (std::abs(res.time - r.claimedTime) > kTimeTolerance + 0.02f * res.time) res.flags |= TimeMismatch;
+        if (res.time > 1.0f && r.actions.size() >= 20 && r.actions.size() / res.time > kMaxHumanRate)
+            res.flags |= Superhuman;
+        return res;
+    }
+};
+
+// BOARD CODEC — сжатие поля для архивов и снимков.
+// Плоскости кодируются адаптивным двоичным range-кодером, вероятность бита
+// берётся из контекста уже закодированных клеток:
+//   мины     — оставшаяся плотность (число мин известно заранее, поэтому
+//              хвост поля часто не кодируется вовсе);
+//   открытые — мина/ноль в клетке, открытость соседей слева/сверху
+//              и открытый ноль среди них;
+//   флаги    — только у закрытых клеток: мина, открытые соседи, флаги
+//              соседей слева/сверху.
+// Формат: varint W, H, число мин, затем поток range-кодера.
+
+// Кодер в стиле LZMA; первый байт потока всегда нулевой и не пишется,
+// хвостовые нули тоже отбрасываются (декодер читает за концом нули).
+class RangeEncoder {
+    std::vector<unsigned char>& out;
+    size_t start;
+    std::uint64_t low = 0;
+    std::uint32_t range = 0xFFFFFFFFu;
+    unsigned char cache = 0;
+    std::uint64_t cacheSize = 1;
+    bool leading = true;
+
+    void shiftLow() {
+        if ((std::uint32_t)low < 0xFF000000u || (low >> 32) != 0) {
+            unsigned char carry = (unsigned char)(low >> 32);
+            unsigned char temp = cache;
+            do {
+                if (!leading) out.push_back((unsigned char)(temp + carry));
+                leading = false;
+                temp = 0xFF;
+            } while (--cacheSize != 0);
+            cache = (unsigned char)(low >> 24);
+        }
+        cacheSize++;
+        low = (low & 0x00FFFFFFu) << 8;
+    }
+
+public:
+    static constexpr int kProbBits = 12;
+    static constexpr int kAdapt = 4;
+
+    explicit RangeEncoder(std::vector<unsigned char>& o) : out(o), start(o.size()) {}
+
+    void encode(std::uint16_t& prob, int bit) {
+        std::uint32_t bound = (range >> kProbBits) * prob;
+        if (!bit) { range = bound; prob += ((1u << kProbBits) - prob) >> kAdapt; }
+        else      { low += bound; range -= bound; prob -= prob >> kAdapt; }
+        while (range < (1u << 24)) { range <<= 8; shiftLow(); }
+    }
+
+    void flush() {
+        // Любое число из [low, low + range) подходит; range >= 2^24, поэтому
+        // округлённое вверх до 2^24 тоже в интервале, а его младшие байты — нули
+        low = (low + 0xFFFFFFu) & ~(std::uint64_t)0xFFFFFFu;
+        for (int i = 0; i < 5; i++) shiftLow();
+        while (out.size() > start && out.back() == 0) out.pop_back();
+    }
+};
+
+class RangeDecoder {
+    const unsigned char* p;
+    const unsigned char* end;
+    std::uint32_t range = 0xFFFFFFFFu, code = 0;
+
+    unsigned char next() { return p < end ? *p++ : 0; }
+
+public:
+    static constexpr int kProbBits = RangeEncoder::kProbBits;
+    static constexpr int kAdapt = RangeEncoder::kAdapt;
+
+    RangeDecoder(const unsigned char* b, const unsigned char* e) : p(b), end(e) {
+        for (int i = 0; i < 4; i++) code = (code << 8) | next();
+    }
+
+    int decode(std::uint16_t& prob) {
+        std::uint32_t bound = (range >> kProbBits) * prob;
+        int bit;
+        if (code < bound) { range = bound; prob += ((1u << kProbBits) - prob) >> kAdapt; bit = 0; }
+        else              { code -= bound; range -= bound; prob -= prob >> kAdapt; bit = 1; }
+        while (range < (1u << 24)) { range <<= 8; code = (code << 8) | next(); }
+        return bit;
+    }
+};
+
+class BoardCodec {
+public:
+    // Рабочие буферы (переиспользуются между вызовами)
+    struct Workspace { std::vector<unsigned char> sum, col; };
+
+private:
+    static constexpr long long kOne = 1 << RangeEncoder::kProbBits;
+
+    struct Model {
+        std::uint16_t exploded = (std::uint16_t)(kOne / 2);
+        std::uint16_t opened[8];
+        std::uint16_t flag[16];
+        std::uint16_t nearZero = (std::uint16_t)(kOne / 32); // почти всегда открыта
+        Model() {
+            std::fill(opened, opened + 8, (std::uint16_t)(kOne / 2));
+            std::fill(flag, flag + 16, (std::uint16_t)(kOne / 2));
+        }
+    };
+
+    struct Encoder {
+        static constexpr bool kDecoding = false;
+        RangeEncoder rc;
+        int bit(std::uint16_t& prob, int value) { rc.encode(prob, value); return value; }
+    };
+    struct Decoder {
+        static constexpr bool kDecoding = true;
+        RangeDecoder rc;
+        int bit(std::uint16_t& prob, int) { return rc.decode(prob); }
+    };
+
+    // Одна модель на оба направления: кодер читает плоскости, декодер их заполняет
+    template <class C, class P>
+    static void run(C& coder, P& b, int mines, Workspace& ws) {
+        Model m;
+        const int W = b.W, H = b.H;
+        const size_t cells = (size_t)W * H;
+
+        // Мины расставлены равномерно: точная вероятность rem/left даёт
+        // log2 C(W*H, MINES) бит — информационную границу. Деление — только
+        // после найденной мины и раз в 64 клетки.
+        long long left = (long long)cells, rem = mines;
+        std::uint16_t p0 = 0;
+        int stale = 0;
+        for (size_t i = 0; i < cells; i++) {
+            int bit;
+            if (rem == 0)         bit = 0;
+            else if (rem == left) bit = 1;
+            else {
+                if (stale-- <= 0) {
+                    p0 = (std::uint16_t)std::min<long long>(kOne - 1,
+                        std::max<long long>(1, (left - rem) * kOne / left));
+                    stale = 63;
+                }
+                std::uint16_t p = p0;
+                bit = coder.bit(p, b.mine[i]);
+                if (bit) stale = 0;
+            }
+            if constexpr (C::kDecoding) b.mine[i] = (unsigned char)bit;
+            rem -= bit;
+            left--;
+        }
+
+        // Проигрыш раскрывает всё поле: один бит вместо двух плоскостей
+        int exploded = 0;
+        if constexpr (!C::kDecoding)
+            for (size_t i = 0; i < cells && !exploded; i++) exploded = b.mine[i] & b.opened[i];
+        exploded = coder.bit(m.exploded, exploded);
+        if (exploded) {
+            if constexpr (C::kDecoding) {
+                std::fill(b.opened.begin(), b.opened.end(), (unsigned char)1);
+                std::fill(b.flag.begin(), b.flag.end(), (unsigned char)0);
+            }
+            return;
+        }
+
+        boxSum3x3(b.mine.data(), W, H, ws.sum, ws.col);
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++) {
+                size_t i = (size_t)y * W + x;
+                int bit = 0;
+                if (!b.mine[i]) { // без взрыва мины закрыты
+                    // Уже известные соседи (слева и сверху): открытый ноль рядом
+                    // открывает клетку почти наверняка — кроме флага, поставленного
+                    // до проёма (и, может быть, снятого потом), поэтому бит всё же
+                    // кодируется, но в своём контексте
+                    int open = 0, openZero = 0;
+                    auto causal = [&](size_t n) { open += b.opened[n]; openZero |= b.opened[n] & (ws.sum[n] == 0); };
+                    if (x > 0) causal(i - 1);
+                    if (y > 0) {
+                        causal(i - W);
+                        if (x > 0)     causal(i - W - 1);
+                        if (x + 1 < W) causal(i - W + 1);
+                    }
+                    if (openZero) bit = coder.bit(m.nearZero, b.opened[i]);
+                    else bit = coder.bit(m.opened[(ws.sum[i] == 0) | std::min(open, 3) << 1], b.opened[i]);
+                }
+                if constexpr (C::kDecoding) b.opened[i] = (unsigned char)bit;
+            }
+
+        // Флаги ставят у открытой области: открытость соседей уже известна
+        boxSum3x3(b.opened.data(), W, H, ws.sum, ws.col);
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++) {
+                size_t i = (size_t)y * W + x;
+                int bit = 0;
+                if (!b.opened[i]) { // на открытой клетке флага нет
+                    int ctx = b.mine[i] | (ws.sum[i] > 0) << 1 | (x > 0 ? b.flag[i - 1] << 2 : 0)
+                            | (y > 0 ? b.flag[i - W] << 3 : 0);
+                    bit = coder.bit(m.flag[ctx], b.flag[i]);
+                }
+                if constexpr (C::kDecoding) b.flag[i] = (unsigned char)bit;
+            }
+    }
 
-        gameOver = true;
-        stopTimer();
+    static void putVarint(std::vector<unsigned char>& out, std::uint32_t v) {
+        while (v >= 0x80) { out.push_back((unsigned char)(v | 0x80)); v >>= 7; }
+        out.push_back((unsigned char)v);
+    }
+    static bool getVarint(const unsigned char*& p, const unsigned char* end, std::uint32_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p == end) return false;
+            unsigned char c = *p++;
+            v |= (std::uint32_t)(c & 0x7F) << shift;
+            if (!(c & 0x80)) return true;
+        }
+        return false;
     }
 
-    int flagsCount() const {
-        int f = 0;
-        for (int y = 0; y < H; y++)
-            for (int x = 0; x < W; x++)
-                if (field[y][x].state->isFlagged())
-                    f++;
-        return f;
+public:
+    static constexpr int kMaxSide = 1 << 15;
+
+    // Дописывает сжатое поле в конец out
+    static void encode(const BoardPlanes& b, std::vector<unsigned char>& out, Workspace& ws) {
+        int mines = b.mineCount();
+        putVarint(out, (std::uint32_t)b.W);
+        putVarint(out, (std::uint32_t)b.H);
+        putVarint(out, (std::uint32_t)mines);
+        Encoder e{RangeEncoder(out)};
+        run(e, b, mines, ws);
+        e.rc.flush();
     }
 
-    void checkWinOpen() {
-        // Победа по открытым клеткам
-        for (int y = 0; y < H; y++)
-            for (int x = 0; x < W; x++)
-                if (!field[y][x].content->isMine() && !field[y][x].state->isOpen())
-                    return;
-        win = true;
-        stopTimer();
+    static void encode(const BoardPlanes& b, std::vector<unsigned char>& out) {
+        Workspace ws;
+        encode(b, out, ws);
     }
 
-    void checkWinFlags() {
-        // Победа по флагам: ровно MINES флагов и все на минах
-        int flagged = 0;
-        for (int y = 0; y < H; y++) {
-            for (int x = 0; x < W; x++) {
-                if (field[y][x].state->isFlagged()) {
-                    flagged++;
-                    if (!field[y][x].content->isMine()) return; // ошибка
-                }
-            }
-        }
-        if (flagged == MINES) {
-            win = true;
-            stopTimer();
-        }
+    // false — повреждённый заголовок (содержимое проверяет верификатор поля)
+    static bool decode(const unsigned char* p, const unsigned char* end, BoardPlanes& b,
+                       Workspace& ws) {
+        std::uint32_t w, h, mines;
+        if (!getVarint(p, end, w) || !getVarint(p, end, h) || !getVarint(p, end, mines)) return false;
+        if (w == 0 || h == 0 || w > kMaxSide || h > kMaxSide || mines > (std::uint64_t)w * h) return false;
+        if (b.W != (int)w || b.H != (int)h) b.resize((int)w, (int)h);
+        Decoder d{RangeDecoder(p, end)};
+        run(d, b, (int)mines, ws);
+        return true;
     }
 
-    void checkWin() {
-        checkWinOpen();
-        if (!win) checkWinFlags();
+    static bool decode(const unsigned char* p, const unsigned char* end, BoardPlanes& b) {
+        Workspace ws;
+        return decode(p, end, b, ws);
     }
 };
 
-// Board generator implementation (Strategy concrete)
+// SNAPSHOT — сохранённая партия: "MSS2", время (float), MINES (uint32),
+// первый клик ещё впереди (байт), сжатое поле. До первого клика мин на поле
+// нет — их число берётся из заголовка, а не из плоскостей.
+
+static std::vector<unsigned char> makeSnapshot(const Game& game) {
+    std::vector<unsigned char> out(4 + sizeof(float) + 5);
+    std::uint32_t mines = (std::uint32_t)game.MINES;
+    std::memcpy(&out[0], "MSS2", 4);
+    std::memcpy(&out[4], &game.timeElapsed, sizeof(float));
+    std::memcpy(&out[4 + sizeof(float)], &mines, 4);
+    out[4 + sizeof(float) + 4] = game.firstClick ? 1 : 0;
+    BoardCodec::encode(BoardPlanes::capture(game), out);
+    return out;
+}
 
-class DefaultBoardGenerator final : public IBoardGenerator {
-public:
-    void generate(Game& game, int safeX, int safeY) override {
-        // очистить контент
+// false — не снимок, повреждён или не сходится с заголовком
+// (до первого клика — ни мин, ни открытых клеток; после — мин ровно mines)
+static bool parseSnapshot(const std::vector<unsigned char>& data, BoardPlanes& b, float& time,
+                          int& mines, bool& firstClick) {
+    const size_t head = 4 + sizeof(float) + 5;
+    if (data.size() < head || std::memcmp(data.data(), "MSS2", 4) != 0) return false;
+    std::uint32_t m = 0;
+    std::memcpy(&time, data.data() + 4, sizeof(float));
+    std::memcpy(&m, data.data() + 4 + sizeof(float), 4);
+    unsigned char first = data[4 + sizeof(float) + 4];
+    if (first > 1 || !BoardCodec::decode(data.data() + head, data.data() + data.size(), b)) return false;
+    if ((std::uint64_t)m + 9 > (std::uint64_t)b.W * b.H) return false;
+    mines = (int)m;
+    firstClick = first != 0;
+    if (firstClick)
+        return b.mineCount() == 0 && std::count(b.opened.begin(), b.opened.end(), (unsigned char)1) == 0;
+    return b.mineCount() == mines;
+}
+
+// Сохранение в фоне (кадр не ждёт диска)
+static void saveSnapshot(const Game& game, const std::string& path) {
+    AsyncIoService::Request r;
+    r.path = path;
+    r.data = makeSnapshot(game);
+    r.mode = AsyncIoService::Mode::Truncate;
+    r.fsync = AsyncIoService::Fsync::Always;
+    AsyncIoService::instance().submit(std::move(r));
+}
+
+// Загрузка заменяет игру (размер поля берётся из снимка); false — нет файла или он повреждён
+static bool loadSnapshot(Game& game, const std::string& path) {
+    AsyncIoService::instance().drain(); // снимок мог ещё писаться
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    BoardPlanes planes;
+    float time = 0.0f;
+    int mines = 0;
+    bool firstClick = false;
+    if (!parseSnapshot(data, planes, time, mines, firstClick)) return false;
+    BoardVerifier::Report check = BoardVerifier().verify(planes);
+    if (!check.ok()) {
+        std::printf("%s: %s\n", path.c_str(), check.describe().c_str());
+        return false;
+    }
+    game = Game(planes.W, planes.H, mines,
+                std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+    if (firstClick) {
+        // Мины расставит первый клик; переносятся только флаги
         for (int y = 0; y < game.H; y++)
             for (int x = 0; x < game.W; x++)
-                game.field[y][x].content = game.cellFactory->makeNumberContent(0);
+                if (planes.flag[(size_t)game.index(x, y)]) game.rightClickCell(x, y);
+        return true;
+    }
+    restorePlanes(game, planes);
+    game.timeElapsed = time;
+    return true;
+}
 
-        // поставить мины (не в safe зоне)
-        int placed = 0;
-        std::srand((unsigned)std::time(nullptr));
+// Клетки прямо в отображённом файле поля (формат — saveBoardFile): открытие —
+// один mmap, страницы подгружаются при первом касании, изменения остаются
+// в памяти процесса (copy-on-write). reset() уводит поле в обычную память.
+class MappedBoardStorage final : public IBoardStorage {
+    MappedFile file;
+    PlaneBuffer owned;
+    unsigned char* cells = nullptr;
+    int W = 0, H = 0;
+public:
+    // Файл открывают через mapping() (CopyOnWrite) и, проверив заголовок,
+    // подключают клетки: offset — их начало в файле
+    MappedFile& mapping() { return file; }
+    void attach(size_t offset, int w, int h) {
+        W = w; H = h;
+        cells = file.writableData() + offset;
+    }
 
-        while (placed < game.MINES) {
-            int x = std::rand() % game.W;
-            int y = std::rand() % game.H;
+    const char* name() const override { return "mmap"; }
 
-            if (game.field[y][x].content->isMine()) continue;
-            if (std::abs(x - safeX) <= 1 && std::abs(y - safeY) <= 1) continue;
+    void reset(int w, int h) override {
+        W = w; H = h;
+        file.close();
+        owned.assign((size_t)w * h, 0, MemoryPlacement::instance().boardPages);
+        cells = owned.data();
+    }
 
-            game.field[y][x].content = game.cellFactory->makeMineContent();
-            placed++;
-        }
+    unsigned char get(size_t i) const override { return cells[i]; }
+    void set(size_t i, unsigned char bits) override { cells[i] = (unsigned char)((cells[i] & 0xF0) | (bits & 7)); }
+    void minesPlaced() override { addNeighborCounts(cells, W, H); }
+    size_t bytes() const override { return file.data() ? file.residentBytes() : owned.size(); }
+    size_t mappedBytes() const { return file.size(); }
+};
 
-        // рассчитать числа
-        for (int y = 0; y < game.H; y++) {
-            for (int x = 0; x < game.W; x++) {
-                if (game.field[y][x].content->isMine()) continue;
-                int around = game.countMinesAround(x, y);
-                game.field[y][x].content = game.cellFactory->makeNumberContent(around);
-            }
+// BOARD FILE — поле PlaneBoard на диске в том же виде, что в памяти:
+// заголовок в первой странице ("MSPB", версия, W, H, MINES, счётчики),
+// с 4096 байта — клетки, байт на клетку, как у DenseBoardStorage.
+// Открытие — mmap и одна сверка клеток со счётчиками (BoardVerifier);
+// свой файл можно открыть без неё — тогда страницы читаются по мере игры.
+
+static constexpr size_t kBoardFileHeader = 4096;
+
+// Не в тот файл, из которого поле отображено (усечение под mmap — SIGBUS)
+static bool saveBoardFile(const PlaneBoard& b, const std::string& path) {
+    PlaneBoard::Counters c = b.counters();
+    std::vector<unsigned char> head(kBoardFileHeader, 0);
+    std::uint32_t version = 1, w = (std::uint32_t)b.W, h = (std::uint32_t)b.H, mines = (std::uint32_t)b.MINES;
+    std::uint32_t state = (c.firstClick ? 1u : 0u) | (c.gameOver ? 2u : 0u) | (c.win ? 4u : 0u);
+    std::uint64_t opened = c.opened;
+    std::int32_t flags = c.flags, wrong = c.wrongFlags;
+    std::memcpy(&head[0], "MSPB", 4);
+    std::memcpy(&head[4], &version, 4);
+    std::memcpy(&head[8], &w, 4);
+    std::memcpy(&head[12], &h, 4);
+    std::memcpy(&head[16], &mines, 4);
+    std::memcpy(&head[20], &state, 4);
+    std::memcpy(&head[24], &opened, 8);
+    std::memcpy(&head[32], &flags, 4);
+    std::memcpy(&head[36], &wrong, 4);
+
+    AsyncIoService& io = AsyncIoService::instance();
+    std::atomic<bool> failed{false};
+    auto request = [&](std::vector<unsigned char> data, AsyncIoService::Mode mode) {
+        AsyncIoService::Request r;
+        r.path = path;
+        r.data = std::move(data);
+        r.mode = mode;
+        r.done = [&failed](bool ok) { if (!ok) failed = true; };
+        return r;
+    };
+    io.submit(request(std::move(head), AsyncIoService::Mode::Truncate));
+
+    // Кусками по 16 МБ, не больше четырёх в очереди
+    const size_t cells = (size_t)b.W * b.H, chunk = (size_t)16 << 20;
+    for (size_t from = 0; from < cells; from += chunk) {
+        while (io.metrics().queueDepth > 4) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::vector<unsigned char> data = io.takeBuffer();
+        size_t n = std::min(chunk, cells - from);
+        data.resize(n);
+        for (size_t i = 0; i < n; i++) data[i] = b.cells().get(from + i);
+        io.submit(request(std::move(data), AsyncIoService::Mode::Append));
+    }
+    io.drain();
+    return !failed;
+}
+
+// nullptr — файл не открылся или повреждён (причина в err)
+// trusted — клетки после первого клика не сверяются со счётчиками (свой,
+// только что записанный файл): открытие остаётся одним mmap без чтения
+static std::unique_ptr<PlaneBoard> loadBoardFile(const std::string& path, std::string& err, bool trusted = false) {
+    auto storage = std::make_unique<MappedBoardStorage>();
+    MappedFile& f = storage->mapping();
+    if (!f.open(path, MappedFile::Access::CopyOnWrite)) { err = "cannot open " + path; return nullptr; }
+    const unsigned char* p = f.data();
+    std::uint32_t version = 0, w = 0, h = 0, mines = 0, state = 0;
+    std::uint64_t opened = 0;
+    std::int32_t flags = 0, wrong = 0;
+    if (f.size() < kBoardFileHeader || std::memcmp(p, "MSPB", 4) != 0) { err = "not a board file"; return nullptr; }
+    std::memcpy(&version, p + 4, 4);
+    std::memcpy(&w, p + 8, 4);
+    std::memcpy(&h, p + 12, 4);
+    std::memcpy(&mines, p + 16, 4);
+    std::memcpy(&state, p + 20, 4);
+    std::memcpy(&opened, p + 24, 8);
+    std::memcpy(&flags, p + 32, 4);
+    std::memcpy(&wrong, p + 36, 4);
+    if (version != 1) { err = "unsupported version"; return nullptr; }
+    // Как в parsePresets: 3x3 первого клика должно остаться без мин;
+    // индексы клеток в PlaneBoard и генераторах — int
+    const std::uint64_t area = (std::uint64_t)w * h;
+    if (w == 0 || h == 0 || w > 65536 || h > 65536 || area < 9 || area > 0x7FFFFFFFu || mines > area - 9) {
+        err = "bad size"; return nullptr;
+    }
+    if (f.size() != kBoardFileHeader + area) { err = "truncated cells"; return nullptr; }
+    if (opened > area - mines || flags < 0 || (std::uint64_t)flags > area || wrong < 0 || wrong > flags) {
+        err = "bad counters"; return nullptr;
+    }
+    PlaneBoard::Counters c;
+    c.opened = (size_t)opened;
+    c.flags = flags;
+    c.wrongFlags = wrong;
+    c.firstClick = state & 1;
+    c.gameOver = state & 2;
+    c.win = state & 4;
+
+    // До первого клика мины расставит сам PlaneBoard — клетки должны быть
+    // пустыми. После — клетки, числа и счётчики сверяет BoardVerifier
+    // (один проход по файлу): иначе чужой файл мог бы объявить победу или
+    // проигрыш, которых на поле нет.
+    const unsigned char* cells = p + kBoardFileHeader;
+    if (c.firstClick) {
+        if (opened || flags || wrong || (state & 6)) { err = "bad counters"; return nullptr; }
+        if (std::any_of(cells, cells + area, [](unsigned char v) { return v != 0; })) {
+            err = "cells set before first click"; return nullptr;
         }
+    } else if (!trusted) {
+        BoardVerifier::Report check = BoardVerifier().verify(cells, (int)w, (int)h, (int)mines, c);
+        if (!check.ok()) { err = "inconsistent board: " + check.describe(); return nullptr; }
     }
-};
 
-// State implementations (State pattern concrete states)
+    storage->attach(kBoardFileHeader, (int)w, (int)h);
+    return std::make_unique<PlaneBoard>((int)w, (int)h, (int)mines, std::move(storage), c);
+}
 
-class ClosedState final : public ICellState {
+// ARENA SIMULATION — много партий ботов сразу, для просмотра (--arena N).
+// Потоки симулятора по очереди делают по ходу на каждом своём поле.
+// Снимок видимого поля (encodeVisible) копируется, только если окно его
+// попросило: без просмотра симулятор ничего лишнего не делает.
+
+class ArenaSimulation {
 public:
-    void onLeftClick(Game& game, int x, int y) override {
-        // State pattern: закрытая клетка реагирует на ЛКМ как "открыть"
-        game.revealFromState(x, y);
+    struct Board {
+        std::mutex mtx;
+        std::vector<unsigned char> visible; // последний снимок
+        std::atomic<bool> wanted{false};
+    };
+
+    ArenaSimulation(const GamePreset& p, int count, const std::string& bot)
+        : preset(p), botName(bot)
+    {
+        for (int i = 0; i < count; i++) {
+            boards.push_back(std::make_unique<Board>());
+            boards.back()->visible.assign((size_t)p.W * p.H, VisClosed);
+        }
+        runner = std::thread([this] { run(); });
     }
-    void onRightClick(Game& game, int x, int y) override {
-        // State pattern: закрытая клетка реагирует на ПКМ как "флаг"
-        game.toggleFlagFromState(x, y);
+
+    ~ArenaSimulation() {
+        stop = true;
+        runner.join();
     }
-    bool isOpen() const override { return false; }
-    bool isFlagged() const override { return false; }
-};
 
-class OpenedState final : public ICellState {
-public:
-    void onLeftClick(Game&, int, int) override {}
-    void onRightClick(Game&, int, int) override {}
-    bool isOpen() const override { return true; }
-    bool isFlagged() const override { return false; }
-};
+    int size() const { return (int)boards.size(); }
+    const GamePreset& gamePreset() const { return preset; }
 
-class FlaggedState final : public ICellState {
-public:
-    void onLeftClick(Game&, int, int) override {}
-    void onRightClick(Game& game, int x, int y) override {
-        // State pattern: ПКМ на флаге -> снять флаг -> перейти в ClosedState
-        game.field[y][x].state = Game::makeClosedState();
+    // Окно просит свежие снимки (обновятся после ближайшего хода)
+    void requestSnapshots() {
+        for (auto& b : boards) b->wanted.store(true, std::memory_order_relaxed);
     }
-    bool isOpen() const override { return false; }
-    bool isFlagged() const override { return true; }
-};
 
-// Фабрики состояний (облегчают переключение состояния)
-std::unique_ptr<ICellState> Game::makeClosedState()  { return std::make_unique<ClosedState>(); }
-std::unique_ptr<ICellState> Game::makeOpenedState()  { return std::make_unique<OpenedState>(); }
-std::unique_ptr<ICellState> Game::makeFlaggedState() { return std::make_unique<FlaggedState>(); }
+    void read(int i, std::vector<unsigned char>& out) {
+        std::lock_guard<std::mutex> lock(boards[i]->mtx);
+        out = boards[i]->visible;
+    }
 
-// Abstract Factory: начальная клетка (пустая и закрытая)
-Cell DefaultCellFactory::makeInitialCell() const {
-    Cell c;
-    c.content = CellContentFactory::makeEmpty();
-    c.state   = Game::makeClosedState();
-    return c;
-}
+    std::uint64_t gamesPlayed() const { return played.load(std::memory_order_relaxed); }
+    std::uint64_t gamesWon() const { return won.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::unique_ptr<Game> game;
+        std::unique_ptr<IBotPolicy> bot;
+        int moves = 0;
+    };
+
+    GamePreset preset;
+    std::string botName;
+    std::vector<std::unique_ptr<Board>> boards;
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> played{0}, won{0}, nextGame{0};
+    std::thread runner;
+
+    void startGame(Slot& s) {
+        std::uint32_t seed = mixSeed(nextGame++);
+        s.game->boardGenerator->reseed(seed);
+        s.game->resetField();
+        s.bot = makeBotPolicy(botName, seed);
+        s.moves = 0;
+    }
+
+    void run() {
+        int count = (int)boards.size();
+        int n = (int)std::min<unsigned>(workerCount(), (unsigned)count);
+        // Поток w ведёт поля w, w+n, w+2n, ...
+        parallelFor(n, [&](int w, int) {
+            std::vector<std::pair<int, Slot>> mine;
+            for (int i = w; i < count; i += n) {
+                Slot s;
+                s.game = std::make_unique<Game>(preset.W, preset.H, preset.MINES,
+                    std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+                startGame(s);
+                mine.push_back({i, std::move(s)});
+            }
+            const int moveLimit = preset.W * preset.H * 4;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (auto& [i, s] : mine) {
+                    Game& g = *s.game;
+                    BotMove m;
+                    if (g.gameOver || g.win || s.moves >= moveLimit || !s.bot->nextMove(g, m)) {
+                        played.fetch_add(1, std::memory_order_relaxed);
+                        if (g.win) won.fetch_add(1, std::memory_order_relaxed);
+                        startGame(s);
+                        if (!s.bot->nextMove(g, m)) continue;
+                    }
+                    if (m.flag) g.rightClickCell(m.x, m.y);
+                    else        g.leftClickCell(m.x, m.y);
+                    s.moves++;
+
+                    Board& b = *boards[i];
+                    if (b.wanted.load(std::memory_order_relaxed)) {
+                        std::lock_guard<std::mutex> lock(b.mtx);
+                        encodeVisible(g, b.visible);
+                        b.wanted.store(false, std::memory_order_relaxed);
+                    }
+                }
+            }
+        });
+    }
+};
 
 // THEME (не паттерн строго, но вынесение параметров дизайна)
 
@@ -465,6 +5018,12 @@ struct ThemeFactory {
     }
 };
 
+// SFML: шрифт интерфейса — Arial (Windows), иначе DejaVu (Linux без окон)
+static bool loadUiFont(sf::Font& font) {
+    return font.loadFromFile("C:\\Windows\\Fonts\\arial.ttf")
+        || font.loadFromFile("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf");
+}
+
 // SFML helpers: format time
 
 
@@ -477,26 +5036,406 @@ static std::string formatTime(float sec) {
     return std::string(buf);
 }
 
+// FRAME RASTERIZER — программная отрисовка видимого поля в RGB, без окна
+// и GL (экспорт видео на машинах без дисплея). Клетка — квадрат cell px,
+// цифры и флаг — растровый шрифт 3x5, увеличенный под клетку; сверху полоса
+// с числом мин и временем. Перерисовываются только изменившиеся клетки,
+// и только их прямоугольник пересчитывается в YUV (плоскости хранятся).
+
+class FrameRasterizer {
+    const ITheme& theme;
+    int W, H, cell, hud, hudScale, glyphScale;
+    int width_, height_;           // чётные — для 4:2:0
+    std::vector<unsigned char> pixels;
+    std::vector<unsigned char> yuv;  // Y, затем Cb и Cr по 2x2 пикселя
+    std::vector<unsigned char> prev; // коды прошлого кадра; 255 — не рисовалась
+    bool prevFlash = false;
+    int dirtyX0, dirtyY0, dirtyX1, dirtyY1; // пиксели, изменённые после toYuv
+
+    void markDirty(int x0, int y0, int x1, int y1) {
+        dirtyX0 = std::min(dirtyX0, x0); dirtyY0 = std::min(dirtyY0, y0);
+        dirtyX1 = std::max(dirtyX1, x1); dirtyY1 = std::max(dirtyY1, y1);
+    }
+
+    // BT.601 full range; прямоугольник расширяется до чётных границ
+    void toYuv() {
+        if (dirtyX0 >= dirtyX1 || dirtyY0 >= dirtyY1) return;
+        int x0 = std::max(0, dirtyX0) & ~1, y0 = std::max(0, dirtyY0) & ~1;
+        int x1 = std::min(width_, (dirtyX1 + 1) & ~1), y1 = std::min(height_, (dirtyY1 + 1) & ~1);
+        size_t luma = (size_t)width_ * height_;
+        unsigned char* Y = yuv.data();
+        unsigned char* U = Y + luma;
+        unsigned char* V = U + luma / 4;
+        for (int y = y0; y < y1; y++)
+            for (int x = x0; x < x1; x++) {
+                const unsigned char* p = &pixels[((size_t)y * width_ + x) * 3];
+                Y[(size_t)y * width_ + x] = (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+            }
+        for (int y = y0; y < y1; y += 2)
+            for (int x = x0; x < x1; x += 2) {
+                int r = 0, g = 0, b = 0;
+                for (int k = 0; k < 4; k++) {
+                    const unsigned char* p = &pixels[(((size_t)y + k / 2) * width_ + x + k % 2) * 3];
+                    r += p[0]; g += p[1]; b += p[2];
+                }
+                size_t o = (size_t)(y / 2) * (width_ / 2) + x / 2;
+                U[o] = (unsigned char)((-43 * r - 85 * g + 128 * b + 4 * 32896) >> 10);
+                V[o] = (unsigned char)((128 * r - 107 * g - 21 * b + 4 * 32896) >> 10);
+            }
+        dirtyX0 = dirtyY0 = INT32_MAX;
+        dirtyX1 = dirtyY1 = 0;
+    }
+
+    static const char* glyph(char ch) {
+        static const char* digits[] = {
+            "111101101101111", "010110010010111", "111001111100111", "111001111001111",
+            "101101111001001", "111100111001111", "111100111101111", "111001001001001",
+            "111101111101111", "111101111001111"};
+        if (ch >= '0' && ch <= '9') return digits[ch - '0'];
+        if (ch == ':') return "000010000010000";
+        if (ch == '-') return "000000111000000";
+        if (ch == 'F') return "111100110100100";
+        return nullptr;
+    }
+
+    void fillRect(int x0, int y0, int w, int h, const sf::Color& c) {
+        int x1 = std::min(width_, x0 + w), y1 = std::min(height_, y0 + h);
+        for (int y = std::max(0, y0); y < y1; y++)
+            for (int x = std::max(0, x0); x < x1; x++) {
+                unsigned char* p = &pixels[((size_t)y * width_ + x) * 3];
+                p[0] = c.r; p[1] = c.g; p[2] = c.b;
+            }
+    }
+
+    void drawGlyph(char ch, int x, int y, int s, const sf::Color& c) {
+        const char* g = glyph(ch);
+        if (!g) return;
+        for (int r = 0; r < 5; r++)
+            for (int k = 0; k < 3; k++)
+                if (g[r * 3 + k] == '1') fillRect(x + k * s, y + r * s, s, s, c);
+    }
+
+    void drawString(const std::string& s, int x, int y) {
+        for (char ch : s) {
+            drawGlyph(ch, x, y, hudScale, sf::Color::Black);
+            x += 4 * hudScale;
+        }
+    }
+
+    void drawCell(int x, int y, unsigned char code, bool flash) {
+        int px = x * cell, py = hud + y * cell;
+        int pad = cell >= 6 ? 1 : 0;
+        markDirty(px, py, px + cell, py + cell);
+        fillRect(px, py, cell, cell, theme.bgColor());
+        sf::Color c = code <= 8 ? theme.cellOpenedColor()
+                    : code == VisClosed ? theme.cellClosedColor()
+                    : code == VisFlag ? theme.cellFlagColor()
+                    : flash ? theme.mineFlashColor() : theme.mineColor();
+        fillRect(px + pad, py + pad, cell - 2 * pad, cell - 2 * pad, c);
+
+        if (glyphScale == 0) return;
+        int gx = px + (cell - 3 * glyphScale) / 2, gy = py + (cell - 5 * glyphScale) / 2;
+        if (code >= 1 && code <= 8)
+            drawGlyph((char)('0' + code), gx, gy, glyphScale, theme.numberColor(code));
+        else if (code == VisFlag)
+            drawGlyph('F', gx, gy, glyphScale, theme.flagTextColor());
+    }
+
+public:
+    FrameRasterizer(const ITheme& t, int w, int h, int cellPx)
+        : theme(t), W(w), H(h), cell(std::max(1, cellPx))
+    {
+        hudScale = std::max(2, cell / 6);
+        hud = 7 * hudScale;
+        glyphScale = cell >= 6 ? std::max(1, cell / 8) : 0;
+        width_ = (W * cell + 1) & ~1;
+        height_ = (hud + H * cell + 1) & ~1;
+        pixels.assign((size_t)width_ * height_ * 3, 0);
+        yuv.assign((size_t)width_ * height_ * 3 / 2, 0);
+        fillRect(0, 0, width_, height_, theme.bgColor());
+        prev.assign((size_t)W * H, 255);
+        dirtyX0 = dirtyY0 = 0;
+        dirtyX1 = width_; dirtyY1 = height_;
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    const std::vector<unsigned char>& rgb() const { return pixels; }
+
+    void draw(const std::vector<unsigned char>& visible, bool flash, int minesLeft, float time) {
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++) {
+                size_t i = (size_t)y * W + x;
+                unsigned char code = visible[i];
+                if (code != prev[i] || (code == VisMine && flash != prevFlash)) {
+                    drawCell(x, y, code, flash);
+                    prev[i] = code;
+                }
+            }
+        prevFlash = flash;
+
+        markDirty(0, 0, width_, hud);
+        fillRect(0, 0, width_, hud, theme.bgColor());
+        drawString(std::to_string(minesLeft), hudScale, hudScale);
+        std::string t = formatTime(time);
+        drawString(t, width_ - (int)t.size() * 4 * hudScale, hudScale);
+    }
+
+    // Кадр Y4M (C420jpeg): "FRAME\n", затем Y, Cb, Cr
+    void appendY4m(std::vector<unsigned char>& out) {
+        static const char tag[] = "FRAME\n";
+        toYuv();
+        out.insert(out.end(), tag, tag + 6);
+        out.insert(out.end(), yuv.begin(), yuv.end());
+    }
+
+    // Кадр PPM (P6) — поток таких кадров понимает ffmpeg -f image2pipe
+    void appendPpm(std::vector<unsigned char>& out) const {
+        char head[48];
+        int n = std::snprintf(head, sizeof(head), "P6\n%d %d\n255\n", width_, height_);
+        out.insert(out.end(), head, head + n);
+        out.insert(out.end(), pixels.begin(), pixels.end());
+    }
+};
+
+// VIDEO EXPORT — повтор в поток кадров Y4M или PPM без окна.
+// Кадры делятся на отрезки по секунде. Первый проход по повтору сохраняет
+// ключевые кадры (плоскости поля) на началах отрезков; рабочий поток
+// восстанавливает ключевой кадр, доигрывает действия своего отрезка и рисует
+// его кадры. Готовые кадры ждут в буфере перестановки и уходят в файл строго
+// по порядку через AsyncIoService.
+
+class ReplayVideoExporter {
+public:
+    struct Options {
+        int   fps = 30;
+        int   cell = 16;
+        float tail = 1.0f;   // секунд после последнего действия
+        bool  y4m = true;    // иначе поток PPM
+    };
+
+    struct Report {
+        bool          ok = false;
+        int           frames = 0, width = 0, height = 0;
+        double        seconds = 0.0;
+        std::uint64_t bytes = 0;
+    };
+
+    static Report run(const Replay& r, const ITheme& theme, const Options& o, const std::string& path) {
+        Report rep;
+        const GamePreset& p = r.preset;
+        const int fps = std::max(1, o.fps);
+        float lastT = r.actions.empty() ? 0.0f : r.actions.back().t;
+        rep.frames = (int)std::ceil((lastT + o.tail) * fps) + 1;
+        auto frameTime = [&](int f) { return (float)f / fps; };
+
+        auto makeGame = [&] {
+            return std::make_unique<Game>(p.W, p.H, p.MINES, std::make_unique<DefaultCellFactory>(),
+                                          makeBoardGenerator(r.target3bv));
+        };
+        auto apply = [&](Game& g, const ReplayAction& a) {
+            if (a.x < 0 || a.x >= p.W || a.y < 0 || a.y >= p.H) return;
+            if (a.reveal()) g.leftClickCell(a.x, a.y);
+            else            g.rightClickCell(a.x, a.y);
+        };
+
+        // Первый проход: ключевые кадры, начало отсчёта времени, конец партии
+        struct Keyframe {
+            size_t      action = 0;    // первое ещё не применённое действие
+            bool        fresh = true;  // мины ещё не расставлены — играть с начала
+            BoardPlanes planes;
+        };
+        const int slice = fps;
+        const int slices = (rep.frames + slice - 1) / slice;
+        std::vector<Keyframe> keys(slices);
+        float firstT = -1.0f, endT = -1.0f;
+        bool lost = false;
+        {
+            auto g = makeGame();
+            g->boardGenerator->reseed(r.seed);
+            g->resetField();
+            size_t next = 0;
+            for (int s = 0; s < slices; s++) {
+                float t0 = frameTime(s * slice);
+                while (next < r.actions.size() && r.actions[next].t < t0) {
+                    bool first = g->firstClick, over = g->gameOver || g->win;
+                    apply(*g, r.actions[next]);
+                    if (first && !g->firstClick) firstT = r.actions[next].t;
+                    if (!over && (g->gameOver || g->win)) { endT = r.actions[next].t; lost = g->gameOver; }
+                    next++;
+                }
+                keys[s].action = next;
+                keys[s].fresh = g->firstClick;
+                if (!g->firstClick) keys[s].planes = BoardPlanes::capture(*g);
+            }
+            for (; next < r.actions.size(); next++) {
+                bool first = g->firstClick, over = g->gameOver || g->win;
+                apply(*g, r.actions[next]);
+                if (first && !g->firstClick) firstT = r.actions[next].t;
+                if (!over && (g->gameOver || g->win)) { endT = r.actions[next].t; lost = g->gameOver; }
+            }
+        }
+        auto shownTime = [&](float t) {
+            if (firstT < 0.0f || t < firstT) return 0.0f;
+            return (endT >= 0.0f ? std::min(t, endT) : t) - firstT;
+        };
+
+        AsyncIoService& io = AsyncIoService::instance();
+        std::atomic<bool> failed{false};
+        auto request = [&](std::vector<unsigned char> data, AsyncIoService::Mode mode) {
+            AsyncIoService::Request q;
+            q.path = path;
+            q.data = std::move(data);
+            q.mode = mode;
+            q.done = [&failed](bool ok) { if (!ok) failed = true; };
+            return q;
+        };
+
+        unsigned workers = workerCount();
+        std::vector<std::unique_ptr<Game>> games(workers);
+        std::vector<std::unique_ptr<FrameRasterizer>> rasters(workers);
+        for (unsigned w = 0; w < workers; w++) {
+            games[w] = makeGame();
+            rasters[w] = std::make_unique<FrameRasterizer>(theme, p.W, p.H, o.cell);
+        }
+        rep.width = rasters[0]->width();
+        rep.height = rasters[0]->height();
+
+        std::vector<unsigned char> header;
+        if (o.y4m) {
+            char buf[96];
+            int n = std::snprintf(buf, sizeof(buf), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                                  rep.width, rep.height, fps);
+            header.assign(buf, buf + n);
+        }
+        io.submit(request(std::move(header), AsyncIoService::Mode::Truncate));
+
+        // Буфер перестановки: кадр f ждёт, пока не уйдут все кадры до него
+        const int window = slice * ((int)workers + 1);
+        std::vector<std::vector<unsigned char>> ready(window);
+        std::vector<char> filled(window, 0);
+        int nextOut = 0;
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::atomic<std::uint64_t> bytes{0};
+
+        sf::Clock clock;
+        parallelFor(slices, [&](int s, int w) {
+            Game& g = *games[w];
+            FrameRasterizer& raster = *rasters[w];
+            const Keyframe& k = keys[s];
+            if (k.fresh) {
+                g.boardGenerator->reseed(r.seed);
+                g.resetField();
+                for (size_t i = 0; i < k.action; i++) apply(g, r.actions[i]);
+            } else {
+                restorePlanes(g, k.planes);
+            }
+
+            std::vector<unsigned char> visible;
+            std::vector<GameAction> batch; // действия, пришедшиеся на кадр
+            size_t next = k.action;
+            for (int f = s * slice; f < std::min(rep.frames, (s + 1) * slice); f++) {
+                float t = frameTime(f);
+                batch.clear();
+                for (; next < r.actions.size() && r.actions[next].t <= t; next++) {
+                    const ReplayAction& a = r.actions[next];
+                    batch.push_back({a.reveal() ? GameAction::Reveal : GameAction::Flag, a.x, a.y});
+                }
+                if (!batch.empty()) g.apply(batch);
+                encodeVisible(g, visible);
+                bool flash = lost && t >= endT && t < endT + 0.2f;
+                raster.draw(visible, flash, g.MINES - g.flagCount, shownTime(t));
+
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&] { return f < nextOut + window; });
+                }
+                while (io.metrics().queueDepth > (size_t)window) // диск не успевает
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                std::vector<unsigned char> frame = io.takeBuffer();
+                if (o.y4m) raster.appendY4m(frame);
+                else       raster.appendPpm(frame);
+                bytes += frame.size();
+
+                std::lock_guard<std::mutex> lock(mtx);
+                ready[f % window] = std::move(frame);
+                filled[f % window] = 1;
+                std::vector<AsyncIoService::Request> writes;
+                while (filled[nextOut % window]) {
+                    filled[nextOut % window] = 0;
+                    writes.push_back(request(std::move(ready[nextOut % window]), AsyncIoService::Mode::Append));
+                    nextOut++;
+                }
+                if (!writes.empty()) {
+                    io.submitBatch(writes); // под замком — порядок в очереди сохраняется
+                    cv.notify_all();
+                }
+            }
+        });
+        io.drain();
+
+        rep.seconds = clock.getElapsedTime().asSeconds();
+        rep.bytes = bytes;
+        rep.ok = !failed;
+        return rep;
+    }
+};
+
 // Layout (геометрия интерфейса)
+// Окно любого размера: клетка подбирается так, чтобы поле поместилось под
+// HUD (но не крупнее двух базовых клеток), HUD привязан к правому краю.
+// scale — масштаб интерфейса под плотность пикселей экрана (DPI):
+// размеры HUD, высота полосы HUD и предел клетки умножаются на него.
 
 struct Layout {
-    int WINDOW_W = 800;
-    int WINDOW_H = 800;
-    int CELL     = 40;
-    int OFFSET_Y = 110;
+    static constexpr int kBaseCell  = 40;  // под неё подобраны шрифты темы
+    static constexpr int kHudHeight = 110;
+    static constexpr int kMargin    = 10;
+
+    int   WINDOW_W = 800;
+    int   WINDOW_H = 800;
+    float scale    = 1.0f;
+    int   CELL     = 40;
+    int   OFFSET_Y = 110;
 
     int boardWidthPx  = 0;
     int boardHeightPx = 0;
     int XOFFSET       = 0;
 
+    void resize(int w, int h, float uiScale) {
+        WINDOW_W = std::max(1, w);
+        WINDOW_H = std::max(1, h);
+        scale = uiScale;
+    }
+
     void recompute(const Game& game) {
+        OFFSET_Y = (int)(kHudHeight * scale);
+        int margin = (int)(kMargin * scale);
+        int fitW = (WINDOW_W - 2 * margin) / game.W;
+        int fitH = (WINDOW_H - OFFSET_Y - margin) / game.H;
+        CELL = std::max(1, std::min({fitW, fitH, (int)(2 * kBaseCell * scale)}));
+
         boardWidthPx  = game.W * CELL;
         boardHeightPx = game.H * CELL;
         XOFFSET = (WINDOW_W - boardWidthPx) / 2;
         if (XOFFSET < 0) XOFFSET = 0;
     }
+
+    // Цифры и флаг в клетке: отступы и шрифт темы — пропорционально клетке
+    static float glyphScale(int cell) { return (float)cell / kBaseCell; }
+    static unsigned glyphSize(int themeSize, int cell) {
+        return (unsigned)std::max(1, (int)std::lround(themeSize * glyphScale(cell)));
+    }
 };
 
+// Масштаб интерфейса по экрану: SFML не сообщает DPI, поэтому — по высоте
+// рабочего стола (4K и Retina дают 2). --ui-scale задаёт его явно.
+static float detectUiScale() {
+    unsigned h = sf::VideoMode::getDesktopMode().height;
+    return h >= 2000 ? 2.0f : h >= 1600 ? 1.5f : 1.0f;
+}
+
 // UI widgets (SFML objects)
 
 struct UiWidgets {
@@ -509,36 +5448,120 @@ struct UiWidgets {
     sf::Text status;
     sf::Text minesIndicator;
     sf::Text timerText;
+
+    // Отладочный слой (F3): память подсистем
+    bool               debugVisible = false;
+    sf::RectangleShape debugPanel;
+    sf::Text           debugText;
 };
 
+// SFML: кнопки и строки HUD по раскладке — от правого края окна, в масштабе
+static void placeHud(const Layout& layout, const ITheme& theme, UiWidgets& ui) {
+    float k = layout.scale, right = (float)layout.WINDOW_W;
+    auto size = [&](int px) { return (unsigned)std::lround(px * k); };
+
+    ui.status.setCharacterSize(size(theme.hudTitleSize()));
+    ui.status.setPosition(180 * k, 5 * k);
+
+    ui.restartBtn.setSize(sf::Vector2f(150 * k, 40 * k));
+    ui.restartBtn.setPosition(right - 200 * k, 10 * k);
+    ui.restartText.setCharacterSize(size(20));
+    ui.restartText.setPosition(right - 170 * k, 15 * k);
+
+    ui.menuBtn.setSize(sf::Vector2f(150 * k, 40 * k));
+    ui.menuBtn.setPosition(right - 360 * k, 10 * k);
+    ui.menuText.setCharacterSize(size(20));
+    ui.menuText.setPosition(right - 315 * k, 15 * k);
+
+    ui.minesIndicator.setCharacterSize(size(theme.hudSmallSize()));
+    ui.minesIndicator.setPosition(right - 360 * k, 60 * k);
+    ui.timerText.setCharacterSize(size(theme.hudSmallSize()));
+    ui.timerText.setPosition(right - 360 * k, 82 * k);
+
+    ui.debugText.setCharacterSize(size(12));
+}
+
 // RENDERER (SFML) — здесь используется SFML draw()
+// Рендерер только рисует кадр в цель (окно или RenderTexture);
+// показывает кадр (display) владелец цели.
+
+// Цена последнего кадра — то, что рендерер отдал SFML (для --bench-render)
+struct RenderStats {
+    int    drawCalls = 0;
+    size_t vertices = 0;
+    size_t uploadedBytes = 0; // загружено в текстуры за кадр
+};
+
+// Вершины, которые SFML строит для фигуры (веер: центр, углы, замыкание) и текста (2 треугольника на глиф)
+static size_t shapeVertices(const sf::Shape&) { return 6; }
+static size_t textVertices(const sf::Text& t) {
+    size_t n = 0;
+    const sf::String& str = t.getString();
+    for (size_t i = 0; i < str.getSize(); i++)
+        if (str[i] != ' ' && str[i] != '\n') n += 6;
+    return n;
+}
 
 class IRenderer {
 public:
     virtual ~IRenderer() = default;
-    virtual void render(sf::RenderWindow& window, const Game& game, const Layout& layout, UiWidgets& ui) = 0;
+    virtual void render(sf::RenderTarget& target, const Game& game, const Layout& layout, UiWidgets& ui) = 0;
+    virtual RenderStats lastFrameStats() const { return {}; }
+    // Раскладка изменилась (размер окна, клетки, поле) — пересобрать то, что от неё зависит
+    virtual void onLayoutChanged(const Layout&) {}
+    // Кэши рендерера (текстуры, копии поля); без кэшей — пустой узел
+    virtual MemoryUsage memoryUsage() const { return MemoryUsage("renderer", 0); }
+    // Сбросить кэши — пересоберутся на следующих кадрах; вернёт освобождённые байты
+    virtual size_t releaseCaches() { return 0; }
 };
 
+// SFML: строки интерфейса (общие для всех рендереров)
+static void updateHud(const Game& game, UiWidgets& ui) {
+    if (game.win) ui.status.setString("YOU WIN!");
+    else if (game.gameOver) ui.status.setString("YOU LOSE!");
+    else ui.status.setString("");
+
+    int remaining = game.MINES - game.flagsCount();
+    ui.minesIndicator.setString("Mines: " + std::to_string(remaining));
+    ui.timerText.setString("Time: " + formatTime(game.timeElapsed));
+}
+
+static void drawHud(sf::RenderTarget& target, const UiWidgets& ui, RenderStats& stats) {
+    auto shape = [&](const sf::Shape& sh) { target.draw(sh); stats.drawCalls++; stats.vertices += shapeVertices(sh); };
+    auto text = [&](const sf::Text& t) { target.draw(t); stats.drawCalls++; stats.vertices += textVertices(t); };
+    shape(ui.restartBtn);
+    text(ui.restartText);
+    shape(ui.menuBtn);
+    text(ui.menuText);
+    text(ui.status);
+    text(ui.minesIndicator);
+    text(ui.timerText);
+    if (ui.debugVisible) {
+        shape(ui.debugPanel);
+        text(ui.debugText);
+    }
+}
+
 class SfmlRenderer final : public IRenderer {
     sf::Font& font;
     const ITheme& theme;
+    RenderStats stats;
 public:
     SfmlRenderer(sf::Font& f, const ITheme& t) : font(f), theme(t) {}
 
-    void render(sf::RenderWindow& window, const Game& game, const Layout& layout, UiWidgets& ui) override {
-        // SFML: обновляем строки интерфейса
-        if (game.win) ui.status.setString("YOU WIN!");
-        else if (game.gameOver) ui.status.setString("YOU LOSE!");
-        else ui.status.setString("");
+    RenderStats lastFrameStats() const override { return stats; }
+
+    void render(sf::RenderTarget& target, const Game& game, const Layout& layout, UiWidgets& ui) override {
+        stats = RenderStats();
 
-        int remaining = game.MINES - game.flagsCount();
-        ui.minesIndicator.setString("Mines: " + std::to_string(remaining));
-        ui.timerText.setString("Time: " + formatTime(game.timeElapsed));
+        // SFML: обновляем строки интерфейса
+        updateHud(game, ui);
 
         // SFML: очистка окна (заливка фоном)
-        window.clear(theme.bgColor());
+        target.clear(theme.bgColor());
 
         // SFML: рисуем поле
+        float glyph = Layout::glyphScale(layout.CELL);
         for (int y = 0; y < game.H; y++) {
             for (int x = 0; x < game.W; x++) {
                 sf::RectangleShape r(sf::Vector2f((float)layout.CELL - 2, (float)layout.CELL - 2));
@@ -552,58 +5575,487 @@ public:
                     r.setFillColor(c.content->isMine()
                         ? (game.explosion ? theme.mineFlashColor() : theme.mineColor())
                         : theme.cellOpenedColor());
-                    window.draw(r);
+                    target.draw(r);
+                    stats.drawCalls++;
+                    stats.vertices += shapeVertices(r);
 
                     // SFML: рисуем число
                     if (!c.content->isMine() && c.content->number() > 0) {
                         sf::Text t;
                         t.setFont(font);
                         t.setString(std::to_string(c.content->number()));
-                        t.setCharacterSize(theme.cellNumberSize());
+                        t.setCharacterSize(Layout::glyphSize(theme.cellNumberSize(), layout.CELL));
                         t.setFillColor(theme.numberColor(c.content->number()));
-                        t.setPosition((float)layout.XOFFSET + x * layout.CELL + 10,
-                                      (float)layout.OFFSET_Y + y * layout.CELL + 5);
-                        window.draw(t);
+                        t.setPosition((float)layout.XOFFSET + x * layout.CELL + 10 * glyph,
+                                      (float)layout.OFFSET_Y + y * layout.CELL + 5 * glyph);
+                        target.draw(t);
+                        stats.drawCalls++;
+                        stats.vertices += textVertices(t);
                     }
                 } else {
                     // SFML: закрытая клетка, если флаг — другой цвет
                     r.setFillColor(c.state->isFlagged()
                         ? theme.cellFlagColor()
                         : theme.cellClosedColor());
-                    window.draw(r);
+                    target.draw(r);
+                    stats.drawCalls++;
+                    stats.vertices += shapeVertices(r);
+
+                    // SFML: рисуем букву флага
+                    if (c.state->isFlagged()) {
+                        sf::Text f;
+                        f.setFont(font);
+                        f.setString(theme.flagGlyph());
+                        f.setCharacterSize(Layout::glyphSize(theme.cellFlagSize(), layout.CELL));
+                        f.setFillColor(theme.flagTextColor());
+                        f.setPosition((float)layout.XOFFSET + x * layout.CELL + 10 * glyph,
+                                      (float)layout.OFFSET_Y + y * layout.CELL + 3 * glyph);
+                        target.draw(f);
+                        stats.drawCalls++;
+                        stats.vertices += textVertices(f);
+                    }
+                }
+            }
+        }
+
+        // SFML: рисуем UI элементы
+        drawHud(target, ui, stats);
+    }
+};
+
+// SHADER RENDERER — всё поле одним четырёхугольником.
+// Видимое поле лежит в текстуре состояния (тексель на клетку, код
+// visibleCode в красном канале), фрагментный шейдер по коду выбирает плитку
+// из атласа (фон клетки, цифра или флаг — нарисованы один раз через SFML).
+// Текстура обновляется по журналу изменений Game: изменённые клетки
+// помечают свою плитку 64x64, на кадр загружаются только грязные плитки,
+// и не дольше бюджета кадра (по умолчанию 4 мс).
+// GLSL 1.10 — работает и на программном Mesa (llvmpipe).
+// Без шейдеров или для поля больше максимальной текстуры — SfmlRenderer.
+
+class ShaderRenderer final : public IRenderer {
+    static constexpr int kTile = 64;
+    static constexpr int kFlashCode = VisMine + 1; // мина во время вспышки взрыва
+    static constexpr int kAtlasTiles = kFlashCode + 1;
+
+    sf::Font& font;
+    const ITheme& theme;
+    SfmlRenderer fallback;
+    sf::Shader shader;
+    sf::Texture atlas;
+    int atlasCell = 0;                   // размер клетки, под который нарисован атлас
+    RenderStats stats;
+    bool atlasFailed = false;            // атлас не собрать — рисует fallback
+
+    sf::Texture state;
+    std::vector<sf::Uint8> pixels;       // копия текстуры (RGBA)
+    std::vector<sf::Uint8> upload;       // прямоугольник для update()
+    std::vector<unsigned char> dirtyTile;
+    std::vector<int> dirtyList;
+    int W = 0, H = 0, tilesX = 0;
+    unsigned epoch = 0;
+    size_t logCursor = 0;
+    float budgetMs;                      // время на обновление текстуры за кадр
+    mutable size_t peakMemory = 0;
+
+    static const char* fragmentSource() {
+        return
+            "#version 110\n"
+            "uniform sampler2D state;\n"
+            "uniform sampler2D atlas;\n"
+            "uniform vec2 boardSize;\n"
+            "uniform float atlasTiles;\n"
+            "uniform float flash;\n"
+            "void main() {\n"
+            "    vec2 pos = gl_TexCoord[0].xy * boardSize;\n"
+            "    vec2 cell = floor(pos);\n"
+            "    float code = floor(texture2D(state, (cell + 0.5) / boardSize).r * 255.0 + 0.5);\n"
+            "    if (code == 11.0 && flash > 0.5) code = 12.0;\n"
+            "    vec2 uv = vec2((code + pos.x - cell.x) / atlasTiles, pos.y - cell.y);\n"
+            "    gl_FragColor = texture2D(atlas, uv);\n"
+            "}\n";
+    }
+
+    // Плитки атласа — ровно то, что SfmlRenderer рисует в клетке.
+    // Через Image: текстура RenderTexture хранится перевёрнутой, а шейдер
+    // читает атлас напрямую, без матрицы SFML
+    bool buildAtlas(int cell) {
+        float glyph = Layout::glyphScale(cell);
+        sf::RenderTexture atlasTarget;
+        if (!atlasTarget.create((unsigned)(cell * kAtlasTiles), (unsigned)cell)) return false;
+        atlasTarget.clear(theme.bgColor());
+        for (int code = 0; code < kAtlasTiles; code++) {
+            float x0 = (float)(code * cell);
+            sf::RectangleShape r(sf::Vector2f((float)cell - 2, (float)cell - 2));
+            r.setPosition(x0 + 1, 1);
+            sf::Color fill = theme.cellOpenedColor();
+            if (code == VisClosed)   fill = theme.cellClosedColor();
+            if (code == VisFlag)     fill = theme.cellFlagColor();
+            if (code == VisMine)     fill = theme.mineColor();
+            if (code == kFlashCode)  fill = theme.mineFlashColor();
+            r.setFillColor(fill);
+            atlasTarget.draw(r);
+
+            sf::Text t;
+            t.setFont(font);
+            if (code >= 1 && code <= 8) {
+                t.setString(std::to_string(code));
+                t.setCharacterSize(Layout::glyphSize(theme.cellNumberSize(), cell));
+                t.setFillColor(theme.numberColor(code));
+                t.setPosition(x0 + 10 * glyph, 5 * glyph);
+                atlasTarget.draw(t);
+            } else if (code == VisFlag) {
+                t.setString(theme.flagGlyph());
+                t.setCharacterSize(Layout::glyphSize(theme.cellFlagSize(), cell));
+                t.setFillColor(theme.flagTextColor());
+                t.setPosition(x0 + 10 * glyph, 3 * glyph);
+                atlasTarget.draw(t);
+            }
+        }
+        atlasTarget.display();
+        if (!atlas.loadFromImage(atlasTarget.getTexture().copyToImage())) return false;
+        atlasCell = cell;
+        return true;
+    }
+
+    void setCell(int i, unsigned char code) {
+        if (pixels[(size_t)i * 4] == code) return;
+        pixels[(size_t)i * 4] = code;
+        int t = (i / W / kTile) * tilesX + (i % W) / kTile;
+        if (!dirtyTile[t]) { dirtyTile[t] = 1; dirtyList.push_back(t); }
+    }
+
+    // Новое поле (другая игра или resetField): после resetField все клетки
+    // закрыты, остальное придёт из журнала — поле не обходим
+    void reset(const Game& game) {
+        if (game.W != W || game.H != H) {
+            W = game.W;
+            H = game.H;
+            state.create((unsigned)W, (unsigned)H);
+            tilesX = (W + kTile - 1) / kTile;
+            dirtyTile.assign((size_t)tilesX * ((H + kTile - 1) / kTile), 0);
+        }
+        pixels.assign((size_t)W * H * 4, 255);
+        for (size_t i = 0; i < (size_t)W * H; i++) pixels[i * 4] = VisClosed;
+        dirtyList.clear();
+        for (int t = 0; t < (int)dirtyTile.size(); t++) {
+            dirtyTile[t] = 1;
+            dirtyList.push_back(t);
+        }
+        epoch = game.boardEpoch;
+        logCursor = 0;
+    }
+
+    // Журнал и загрузка плиток — в пределах бюджета кадра; остаток
+    // переходит на следующие кадры (игра уже в новом состоянии, догоняет
+    // только картинка). Одна плитка за кадр загружается всегда.
+    void sync(const Game& game) {
+        if (game.boardEpoch != epoch || game.W != W || game.H != H || logCursor > game.changeLog.size())
+            reset(game);
+
+        sf::Clock clock;
+        const std::int64_t budgetUs = (std::int64_t)(budgetMs * 1000.0f);
+        const std::vector<int>& log = game.changeLog;
+        while (logCursor < log.size()) {
+            size_t end = std::min(log.size(), logCursor + 4096);
+            for (; logCursor < end; logCursor++) {
+                int i = log[logCursor];
+                setCell(i, visibleCode(game.field[i / W][i % W]));
+            }
+            if (clock.getElapsedTime().asMicroseconds() > budgetUs) break;
+        }
+
+        for (bool first = true; !dirtyList.empty(); first = false) {
+            if (!first && clock.getElapsedTime().asMicroseconds() > budgetUs) break;
+            int t = dirtyList.back();
+            dirtyList.pop_back();
+            dirtyTile[t] = 0;
+            int x0 = (t % tilesX) * kTile, y0 = (t / tilesX) * kTile;
+            int w = std::min(kTile, W - x0), h = std::min(kTile, H - y0);
+            upload.resize((size_t)w * h * 4);
+            for (int y = 0; y < h; y++)
+                std::memcpy(upload.data() + (size_t)y * w * 4,
+                            pixels.data() + ((size_t)(y0 + y) * W + x0) * 4, (size_t)w * 4);
+            state.update(upload.data(), (unsigned)w, (unsigned)h, (unsigned)x0, (unsigned)y0);
+            stats.uploadedBytes += upload.size();
+        }
+    }
+
+    ShaderRenderer(sf::Font& f, const ITheme& t, float budget) : font(f), theme(t), fallback(f, t), budgetMs(budget) {}
+
+public:
+    // nullptr — шейдеры недоступны (тогда нужен SfmlRenderer)
+    static std::unique_ptr<ShaderRenderer> create(sf::Font& font, const ITheme& theme, int cell,
+                                                  float budgetMs = 4.0f) {
+        if (!sf::Shader::isAvailable()) return nullptr;
+        std::unique_ptr<ShaderRenderer> r(new ShaderRenderer(font, theme, budgetMs));
+        if (!r->shader.loadFromMemory(fragmentSource(), sf::Shader::Fragment)) return nullptr;
+        if (!r->buildAtlas(cell)) return nullptr;
+        return r;
+    }
+
+    // Текстура состояния от размера клетки не зависит — перерисовывается только атлас
+    void onLayoutChanged(const Layout& layout) override {
+        if (layout.CELL == atlasCell) return;
+        atlasFailed = !buildAtlas(layout.CELL);
+    }
+
+    // Текстуры считаются по RGBA; на программном GL (Mesa) они тоже в памяти процесса
+    MemoryUsage memoryUsage() const override {
+        sf::Vector2u st = state.getSize(), at = atlas.getSize();
+        MemoryUsage u("renderer (shader)", 0);
+        u.add(MemoryUsage("state texture", (size_t)st.x * st.y * 4));
+        u.add(MemoryUsage("glyph atlas", (size_t)at.x * at.y * 4));
+        u.add(MemoryUsage("state copy", vectorBytes(pixels) + vectorBytes(upload)));
+        u.add(MemoryUsage("dirty tiles", vectorBytes(dirtyTile) + vectorBytes(dirtyList)));
+        return u.track(peakMemory);
+    }
+
+    // Копия состояния восстановится из журнала Game (как после resetField)
+    size_t releaseCaches() override {
+        size_t freed = vectorBytes(pixels) + vectorBytes(upload);
+        std::vector<sf::Uint8>().swap(pixels);
+        std::vector<sf::Uint8>().swap(upload);
+        epoch = 0;
+        return freed;
+    }
+
+    RenderStats lastFrameStats() const override { return stats; }
+
+    void render(sf::RenderTarget& target, const Game& game, const Layout& layout, UiWidgets& ui) override {
+        unsigned maxSide = sf::Texture::getMaximumSize();
+        if (atlasFailed || (unsigned)game.W > maxSide || (unsigned)game.H > maxSide) {
+            fallback.render(target, game, layout, ui);
+            stats = fallback.lastFrameStats();
+            return;
+        }
+        stats = RenderStats();
+        sync(game);
+        updateHud(game, ui);
+        target.clear(theme.bgColor());
+
+        // Один четырёхугольник на всё поле; texCoords — в клетках (текстура состояния)
+        float x0 = (float)layout.XOFFSET, y0 = (float)layout.OFFSET_Y;
+        float x1 = x0 + (float)game.W * layout.CELL, y1 = y0 + (float)game.H * layout.CELL;
+        sf::Vertex quad[4] = {
+            sf::Vertex(sf::Vector2f(x0, y0), sf::Vector2f(0, 0)),
+            sf::Vertex(sf::Vector2f(x1, y0), sf::Vector2f((float)game.W, 0)),
+            sf::Vertex(sf::Vector2f(x1, y1), sf::Vector2f((float)game.W, (float)game.H)),
+            sf::Vertex(sf::Vector2f(x0, y1), sf::Vector2f(0, (float)game.H)),
+        };
+        shader.setUniform("state", sf::Shader::CurrentTexture);
+        shader.setUniform("atlas", atlas);
+        shader.setUniform("boardSize", sf::Vector2f((float)game.W, (float)game.H));
+        shader.setUniform("atlasTiles", (float)kAtlasTiles);
+        shader.setUniform("flash", game.explosion ? 1.0f : 0.0f);
+        sf::RenderStates states;
+        states.texture = &state;
+        states.shader = &shader;
+        target.draw(quad, 4, sf::Quads, states);
+        stats.drawCalls++;
+        stats.vertices += 4;
+
+        drawHud(target, ui, stats);
+    }
+};
+
+// Factory: рендерер поля — шейдерный, если видеокарта (или Mesa) умеет шейдеры
+static std::unique_ptr<IRenderer> makeBoardRenderer(sf::Font& font, const ITheme& theme, int cell) {
+    if (std::unique_ptr<ShaderRenderer> r = ShaderRenderer::create(font, theme, cell)) return r;
+    return std::make_unique<SfmlRenderer>(font, theme);
+}
+
+// ARENA VIEW — все поля арены одной текстурой: тексель на клетку, между
+// полями зазор в тексель; рисуется одним четырёхугольником. Клик по полю —
+// крупный вид (клетки одним VertexArray, цифры и флаги текстом).
+
+class ArenaView {
+    ArenaSimulation& sim;
+    sf::Font& font;
+    const ITheme& theme;
+    sf::FloatRect area;                  // часть окна под поля
+    int cols = 1, rows = 1, texW = 1, texH = 1;
+    std::vector<sf::Uint8> pixels;
+    sf::Texture texture;
+    sf::FloatRect gridRect;              // где текстура на экране
+    std::vector<unsigned char> snap;
+    std::vector<std::vector<unsigned char>> last; // снимки для крупного вида
+    int zoomed = -1;
+    sf::Color palette[VisMine + 1];
+
+    void fill(int tx, int ty, const sf::Color& c) {
+        sf::Uint8* p = &pixels[((size_t)ty * texW + tx) * 4];
+        p[0] = c.r; p[1] = c.g; p[2] = c.b; p[3] = 255;
+    }
+
+public:
+    ArenaView(ArenaSimulation& s, sf::Font& f, const ITheme& t, const sf::FloatRect& screenArea)
+        : sim(s), font(f), theme(t), area(screenArea), last(s.size())
+    {
+        const GamePreset& p = sim.gamePreset();
+        // Сетка примерно под пропорции окна
+        double aspect = (area.width / (p.W + 1)) / (area.height / (p.H + 1));
+        cols = std::max(1, (int)std::ceil(std::sqrt(sim.size() * aspect)));
+        rows = (sim.size() + cols - 1) / cols;
+        texW = cols * (p.W + 1) + 1;
+        texH = rows * (p.H + 1) + 1;
+        pixels.assign((size_t)texW * texH * 4, 255);
+        for (int y = 0; y < texH; y++)
+            for (int x = 0; x < texW; x++) fill(x, y, theme.bgColor());
+        texture.create((unsigned)texW, (unsigned)texH);
+
+        float scale = std::min(area.width / texW, area.height / texH);
+        gridRect = sf::FloatRect(area.left + (area.width - texW * scale) / 2, area.top,
+                                 texW * scale, texH * scale);
+
+        for (int n = 0; n <= 8; n++) {
+            sf::Color c = theme.cellOpenedColor();
+            int d = n * 14;
+            palette[n] = sf::Color((sf::Uint8)std::max(0, c.r - d), (sf::Uint8)std::max(0, c.g - d),
+                                   (sf::Uint8)std::max(0, c.b - d / 2));
+        }
+        palette[VisClosed] = theme.cellClosedColor();
+        palette[VisFlag] = theme.cellFlagColor();
+        palette[VisMine] = theme.mineColor();
+    }
+
+    bool zoomedIn() const { return zoomed >= 0; }
+    void unzoom() { zoomed = -1; }
+
+    void click(int mx, int my) {
+        if (zoomed >= 0) { zoomed = -1; return; }
+        if (!gridRect.contains((float)mx, (float)my)) return;
+        const GamePreset& p = sim.gamePreset();
+        int tx = (int)((mx - gridRect.left) / gridRect.width * texW);
+        int ty = (int)((my - gridRect.top) / gridRect.height * texH);
+        int i = (ty / (p.H + 1)) * cols + tx / (p.W + 1);
+        if (i < sim.size()) zoomed = i;
+    }
+
+    // Снимки нужны только видимым полям
+    void request() {
+        sim.requestSnapshots();
+    }
 
-                    // SFML: рисуем букву флага
-                    if (c.state->isFlagged()) {
-                        sf::Text f;
-                        f.setFont(font);
-                        f.setString(theme.flagGlyph());
-                        f.setCharacterSize(theme.cellFlagSize());
-                        f.setFillColor(theme.flagTextColor());
-                        f.setPosition((float)layout.XOFFSET + x * layout.CELL + 10,
-                                      (float)layout.OFFSET_Y + y * layout.CELL + 3);
-                        window.draw(f);
-                    }
+    void update() {
+        const GamePreset& p = sim.gamePreset();
+        for (int i = 0; i < sim.size(); i++) {
+            if (zoomed >= 0 && i != zoomed) continue;
+            sim.read(i, snap);
+            last[i] = snap;
+            int x0 = (i % cols) * (p.W + 1) + 1, y0 = (i / cols) * (p.H + 1) + 1;
+            for (int y = 0; y < p.H; y++)
+                for (int x = 0; x < p.W; x++) fill(x0 + x, y0 + y, palette[snap[(size_t)y * p.W + x]]);
+        }
+        if (zoomed < 0) texture.update(pixels.data());
+    }
+
+    void draw(sf::RenderTarget& target) {
+        if (zoomed < 0) {
+            float x0 = gridRect.left, y0 = gridRect.top;
+            float x1 = x0 + gridRect.width, y1 = y0 + gridRect.height;
+            sf::Vertex quad[4] = {
+                sf::Vertex(sf::Vector2f(x0, y0), sf::Vector2f(0, 0)),
+                sf::Vertex(sf::Vector2f(x1, y0), sf::Vector2f((float)texW, 0)),
+                sf::Vertex(sf::Vector2f(x1, y1), sf::Vector2f((float)texW, (float)texH)),
+                sf::Vertex(sf::Vector2f(x0, y1), sf::Vector2f(0, (float)texH)),
+            };
+            target.draw(quad, 4, sf::Quads, sf::RenderStates(&texture));
+            return;
+        }
+
+        // Крупный вид одного поля
+        const GamePreset& p = sim.gamePreset();
+        const std::vector<unsigned char>& v = last[zoomed];
+        if (v.size() != (size_t)p.W * p.H) return;
+        float cell = std::floor(std::min(area.width / p.W, area.height / p.H));
+        float ox = area.left + (area.width - cell * p.W) / 2, oy = area.top;
+        sf::VertexArray quads(sf::Quads, (size_t)p.W * p.H * 4);
+        for (int y = 0; y < p.H; y++)
+            for (int x = 0; x < p.W; x++) {
+                size_t i = (size_t)y * p.W + x;
+                sf::Color c = v[i] <= 8 ? theme.cellOpenedColor() : palette[v[i]];
+                float l = ox + x * cell + 1, t = oy + y * cell + 1, r = l + cell - 2, b = t + cell - 2;
+                quads[i * 4 + 0] = sf::Vertex(sf::Vector2f(l, t), c);
+                quads[i * 4 + 1] = sf::Vertex(sf::Vector2f(r, t), c);
+                quads[i * 4 + 2] = sf::Vertex(sf::Vector2f(r, b), c);
+                quads[i * 4 + 3] = sf::Vertex(sf::Vector2f(l, b), c);
+            }
+        target.draw(quads);
+
+        sf::Text text;
+        text.setFont(font);
+        text.setCharacterSize((unsigned)std::max(8.0f, cell * 0.6f));
+        for (int y = 0; y < p.H; y++)
+            for (int x = 0; x < p.W; x++) {
+                unsigned char code = v[(size_t)y * p.W + x];
+                if (code >= 1 && code <= 8) {
+                    text.setString(std::to_string(code));
+                    text.setFillColor(theme.numberColor(code));
+                } else if (code == VisFlag) {
+                    text.setString(theme.flagGlyph());
+                    text.setFillColor(theme.flagTextColor());
+                } else {
+                    continue;
                 }
+                text.setPosition(ox + x * cell + cell * 0.3f, oy + y * cell + cell * 0.1f);
+                target.draw(text);
             }
-        }
+    }
+};
 
-        // SFML: рисуем UI элементы
-        window.draw(ui.restartBtn);
-        window.draw(ui.restartText);
-        window.draw(ui.menuBtn);
-        window.draw(ui.menuText);
-        window.draw(ui.status);
-        window.draw(ui.minesIndicator);
-        window.draw(ui.timerText);
-
-        // SFML: показать кадр
-        window.display();
+// REPLAY RECORDER — запись текущей партии; по её окончании (события Won/Lost)
+// повтор дописывается строкой в файл (формат — Replay::toLine)
+
+class ReplayRecorder final : public IGameListener {
+    std::string path;
+    Replay replay;
+    sf::Clock clock;   // время действий — от начала партии
+    bool done = false;
+public:
+    explicit ReplayRecorder(std::string file) : path(std::move(file)) {}
+
+    void begin(const Game& game, int target3bv, std::uint32_t seed) {
+        replay = Replay();
+        replay.preset = {game.W, game.H, game.MINES};
+        replay.target3bv = target3bv;
+        replay.seed = seed;
+        clock.restart();
+        done = false;
+    }
+
+    void record(char kind, int x, int y) {
+        if (!done) replay.actions.push_back({kind, x, y, clock.getElapsedTime().asSeconds()});
+    }
+
+    // Партия не восстановима по зерну (например, загружена из снимка)
+    void cancel() { done = true; }
+
+    MemoryUsage memoryUsage() const {
+        return MemoryUsage("replay buffer", vectorBytes(replay.actions) + path.capacity());
+    }
+
+    void onGameEvent(const Game& game, const GameEvent& e) override {
+        if (e.type != GameEventType::Won && e.type != GameEventType::Lost) return;
+        if (done) return;
+        done = true;
+        replay.claimedWin = game.win;
+        replay.claimedTime = game.timeElapsed;
+
+        // Запись в фоне — кадр не ждёт диска
+        std::string line = replay.toLine() + "\n";
+        AsyncIoService::Request r;
+        r.path = path;
+        r.data.assign(line.begin(), line.end());
+        r.fsync = AsyncIoService::Fsync::Interval; // повтор на диске не позже интервала
+        AsyncIoService::instance().submit(std::move(r));
     }
 };
 
 // INPUT CONTROLLER (SFML events) — здесь используется sf::Event
 
-enum class AppActionType { None, Restart, BackToMenu, Quit };
+enum class AppActionType { None, Restart, BackToMenu, Quit, Hint, SaveSnapshot, LoadSnapshot,
+                           ToggleDebug, DumpMemory };
 struct AppAction { AppActionType type = AppActionType::None; };
 
 class IInputController {
@@ -614,7 +6066,10 @@ public:
 };
 
 class SfmlInputController final : public IInputController {
+    ReplayRecorder* recorder; // может быть nullptr
 public:
+    explicit SfmlInputController(ReplayRecorder* rec = nullptr) : recorder(rec) {}
+
     AppAction handleEvent(sf::RenderWindow& window, const sf::Event& e,
                           Game& game, const Layout& layout, UiWidgets& ui) override
     {
@@ -624,12 +6079,30 @@ public:
             return {AppActionType::Quit};
         }
 
-        // SFML: нас интересуют только клики мыши
+        // SFML: клавиша H — подсказка решателя
+        if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::H)
+            return {AppActionType::Hint};
+
+        // SFML: F5 — сохранить партию, F9 — загрузить
+        if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::F5)
+            return {AppActionType::SaveSnapshot};
+        if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::F9)
+            return {AppActionType::LoadSnapshot};
+
+        // SFML: F3 — отладочный слой, F4 — память подсистем в memory.json
+        if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::F3)
+            return {AppActionType::ToggleDebug};
+        if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::F4)
+            return {AppActionType::DumpMemory};
+
+        // SFML: дальше нас интересуют только клики мыши
         if (e.type != sf::Event::MouseButtonPressed) return {};
 
-        // SFML: получаем координаты клика мыши
-        int mx = e.mouseButton.x;
-        int my = e.mouseButton.y;
+        // SFML: координаты клика мыши в координатах вида (после смены размера
+        // окна, пока раскладка не пересобрана, вид ещё растянут)
+        sf::Vector2f pos = window.mapPixelToCoords(sf::Vector2i(e.mouseButton.x, e.mouseButton.y));
+        int mx = (int)pos.x;
+        int my = (int)pos.y;
 
         // SFML: обработка UI кнопок через getGlobalBounds().contains(...)
         if (ui.restartBtn.getGlobalBounds().contains((float)mx, (float)my))
@@ -650,6 +6123,12 @@ public:
 
         if (x < 0 || x >= game.W || y < 0 || y >= game.H) return {};
 
+        // Повтор: только ходы до конца партии
+        if (recorder && !game.gameOver && !game.win) {
+            if (e.mouseButton.button == sf::Mouse::Left)  recorder->record('L', x, y);
+            if (e.mouseButton.button == sf::Mouse::Right) recorder->record('R', x, y);
+        }
+
         // PATTERN State: не if-else на клетку, а делегирование поведению state
         if (e.mouseButton.button == sf::Mouse::Left)  game.leftClickCell(x, y);
         if (e.mouseButton.button == sf::Mouse::Right) game.rightClickCell(x, y);
@@ -669,9 +6148,29 @@ public:
 class SfmlMenuScreen final : public IMenuScreen {
     sf::Font& font;
     const ITheme& theme;
+    const OpeningTable* previews[3] = {};
+
+    // Мини-карта вероятности победы по первому клику (красный — хуже, зелёный — лучше)
+    void buildPreview(const OpeningTable& t, float left, float top,
+                      std::vector<sf::RectangleShape>& out) const {
+        if (t.W == 0) return;
+        float cell = std::min(50.0f / t.H, 150.0f / t.W);
+        double lo = 1.0, hi = 0.0;
+        for (int i = 0; i < t.W * t.H; i++) { lo = std::min(lo, t.winRate(i)); hi = std::max(hi, t.winRate(i)); }
+        for (int i = 0; i < t.W * t.H; i++) {
+            double k = hi > lo ? (t.winRate(i) - lo) / (hi - lo) : 1.0;
+            sf::RectangleShape r(sf::Vector2f(cell, cell));
+            r.setPosition(left + (i % t.W) * cell, top + (i / t.W) * cell);
+            r.setFillColor(sf::Color((sf::Uint8)(255 * (1 - k)), (sf::Uint8)(200 * k), 60));
+            out.push_back(r);
+        }
+    }
+
 public:
     SfmlMenuScreen(sf::Font& f, const ITheme& t) : font(f), theme(t) {}
 
+    void setPreview(int choice, const OpeningTable* table) { previews[choice - 1] = table; }
+
     int run(sf::RenderWindow &window) override {
         // SFML: создаём текст и кнопки меню
         sf::Text title("Select Difficulty", font, 40);
@@ -699,6 +6198,10 @@ public:
         hardText.setPosition(260, 355);
         hardText.setFillColor(sf::Color::Black);
 
+        std::vector<sf::RectangleShape> previewCells;
+        for (int i = 0; i < 3; i++)
+            if (previews[i]) buildPreview(*previews[i], 380, 150.0f + 100 * i, previewCells);
+
         while (window.isOpen()) {
             sf::Event e;
             while (window.pollEvent(e)) {
@@ -721,6 +6224,7 @@ public:
             window.draw(easyBtn);   window.draw(easyText);
             window.draw(normalBtn); window.draw(normalText);
             window.draw(hardBtn);   window.draw(hardText);
+            for (const sf::RectangleShape& r : previewCells) window.draw(r);
             window.display();
         }
         return 0;
@@ -729,35 +6233,1364 @@ public:
 
 // Factory: create game by difficulty
 
-static Game makeGameByDifficulty(int choice) {
-    int W, H, MINES;
-    switch(choice) {
-        case 1: W=10; H=10; MINES=10; break;
-        case 2: W=14; H=14; MINES=20; break;
-        case 3: W=20; H=20; MINES=40; break;
-        default: W=10; H=10; MINES=10; break;
-    }
+// target3bv > 0 — доска подбирается под заданную сложность (3BV)
+static Game makeGameByDifficulty(int choice, int target3bv = 0) {
+    GamePreset p = presetByDifficulty(choice);
 
-    // Здесь мы собираем игру:
+    // Здесь мы собираем игру (Strategy генерации выбирается тут):
 
     return Game(
-        W, H, MINES,
+        p.W, p.H, p.MINES,
         std::make_unique<DefaultCellFactory>(),
-        std::make_unique<DefaultBoardGenerator>()
+        makeBoardGenerator(target3bv)
     );
 }
 
+// Аргумент пресета для офлайн-режимов: 1|2|3|all|WxHxM
+static std::vector<GamePreset> parsePresets(const std::string& which) {
+    std::vector<GamePreset> presets;
+    GamePreset custom;
+    if (which == "all") {
+        for (int c = 1; c <= 3; c++) presets.push_back(presetByDifficulty(c));
+    } else if (std::sscanf(which.c_str(), "%dx%dx%d", &custom.W, &custom.H, &custom.MINES) == 3
+               && custom.W > 0 && custom.H > 0 && custom.MINES < custom.W * custom.H - 9) {
+        presets.push_back(custom);
+    } else {
+        presets.push_back(presetByDifficulty(std::atoi(which.c_str())));
+    }
+    return presets;
+}
+
+// OFFLINE MODE: анализ первых кликов (без окна)
+// sapper --analyze-openings [1|2|3|all|WxHxM] [maxGamesPerCell]
+
+static int runOpeningAnalysis(int argc, char** argv) {
+    std::vector<GamePreset> presets = parsePresets(argc > 2 ? argv[2] : "all");
+
+    OpeningAnalyzer::Options opt;
+    if (argc > 3) opt.maxGamesPerCell = std::strtoull(argv[3], nullptr, 10);
+
+    for (const GamePreset& p : presets) {
+        std::printf("Analyzing %dx%d, %d mines...\n", p.W, p.H, p.MINES);
+        sf::Clock clock;
+        OpeningTable table;
+        OpeningAnalyzer::Report rep = OpeningAnalyzer::run(p, opt, table);
+
+        std::string path = OpeningTable::cachePath(p.W, p.H, p.MINES);
+        if (!table.save(path)) std::printf("  cannot write %s\n", path.c_str());
+
+        int best = table.bestCell();
+        std::printf("  best first click: (%d, %d), win %.3f, opening %.1f cells\n",
+                    best % p.W, best / p.W, table.winRate(best), table.expectedOpening(best));
+        std::printf("  games: %llu (fixed-size run: %llu), %.1f s -> %s\n",
+                    (unsigned long long)rep.gamesPlayed, (unsigned long long)rep.gamesFixedSize,
+                    clock.getElapsedTime().asSeconds(), path.c_str());
+    }
+    return 0;
+}
+
+// OFFLINE MODE: турнир двух ботов
+// sapper --tournament <botA> <botB> [1|2|3|WxHxM] [maxGames]
+// Боты: solver, solver-openings, random-guess, neural
+
+static int runTournament(int argc, char** argv) {
+    if (argc < 4) {
+        std::printf("usage: --tournament <botA> <botB> [preset] [maxGames]\n");
+        return 1;
+    }
+    std::string nameA = argv[2], nameB = argv[3];
+    if (!makeBotPolicy(nameA, 0) || !makeBotPolicy(nameB, 0)) {
+        std::printf("unknown bot; available: solver, solver-openings, random-guess, "
+                    "neural (needs evaluator.nn)\n");
+        return 1;
+    }
+    GamePreset p = parsePresets(argc > 4 ? argv[4] : "3").front();
+
+    Tournament::Options opt;
+    if (argc > 5) opt.maxGames = std::strtoull(argv[5], nullptr, 10);
+
+    OpeningTable openings;
+    openings.load(OpeningTable::cachePath(p.W, p.H, p.MINES));
+
+    std::printf("Tournament %s (A) vs %s (B) on %dx%d, %d mines\n",
+                nameA.c_str(), nameB.c_str(), p.W, p.H, p.MINES);
+    Tournament::Report r = Tournament::run(p, nameA, nameB, opt, &openings);
+
+    double g = (double)r.games;
+    std::printf("  verdict: %s\n", Tournament::verdictName(r.verdict));
+    std::printf("  games played: %llu of %llu\n",
+                (unsigned long long)r.games, (unsigned long long)opt.maxGames);
+    std::printf("  win rate A %.4f, B %.4f (A only: %llu, B only: %llu)\n",
+                r.winsA / g, r.winsB / g, (unsigned long long)r.onlyA, (unsigned long long)r.onlyB);
+    std::printf("  A - B: %+.4f, 95%% CI [%+.4f, %+.4f]\n", r.diff, r.ciLow, r.ciHigh);
+    std::printf("  time: %.1f s, saved vs fixed-size run: ~%.1f s\n", r.seconds, r.secondsSaved);
+    return 0;
+}
+
+// OFFLINE MODE: скорость нейросетевой оценки (случайные веса, доска эксперта)
+// sapper --bench-evaluator [batch] [hidden] [depth]
+
+static int runEvaluatorBench(int argc, char** argv) {
+    int batch  = argc > 2 ? std::max(1, std::atoi(argv[2])) : 32;
+    int hidden = argc > 3 ? std::max(1, std::atoi(argv[3])) : 16;
+    int depth  = argc > 4 ? std::max(1, std::atoi(argv[4])) : 4;
+
+    NeuralModel model;
+    model.randomize(hidden, depth, 1);
+
+    // Пакет досок эксперта в середине партии
+    std::vector<std::unique_ptr<Game>> games;
+    std::vector<const Game*> boards;
+    SolverBot bot(1);
+    for (int b = 0; b < batch; b++) {
+        games.push_back(std::make_unique<Game>(30, 16, 99,
+            std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>()));
+        games.back()->boardGenerator->reseed(mixSeed(b));
+        for (int m = 0; m < 40 && !games.back()->gameOver && !games.back()->win; m++) {
+            BotMove mv;
+            if (!bot.nextMove(*games.back(), mv)) break;
+            if (mv.flag) games.back()->rightClickCell(mv.x, mv.y);
+            else         games.back()->leftClickCell(mv.x, mv.y);
+        }
+        boards.push_back(games.back().get());
+    }
+
+    NeuralEvaluator evaluator(model);
+    std::vector<std::vector<float>> pMine;
+    sf::Clock clock;
+    int evaluated = 0;
+    while (clock.getElapsedTime().asSeconds() < 2.0f || evaluated == 0) {
+        evaluator.evaluate(boards, pMine);
+        evaluated += batch;
+        if (evaluated >= 1000000) break;
+    }
+    float sec = clock.getElapsedTime().asSeconds();
+    std::printf("%d-layer net, %d hidden channels, batch %d: %.0f expert boards/s on one core\n",
+                depth, hidden, batch, sec > 0 ? evaluated / sec : 0.0f);
+    return 0;
+}
+
+// OFFLINE MODE: выгрузка обучающих позиций
+// sapper --export-dataset <prefix> [preset] [games] [bot]
+// Каждый поток пишет свои шарды <prefix>-w<поток>-<номер>.msds
+
+static int runDatasetExport(int argc, char** argv) {
+    if (argc < 3) {
+        std::printf("usage: --export-dataset <prefix> [preset] [games] [bot]\n");
+        return 1;
+    }
+    std::string prefix = argv[2];
+    GamePreset p = parsePresets(argc > 3 ? argv[3] : "3").front();
+    int games = argc > 4 ? std::max(1, std::atoi(argv[4])) : 10000;
+    std::string botName = argc > 5 ? argv[5] : "solver";
+    if (!makeBotPolicy(botName, 0)) { std::printf("unknown bot %s\n", botName.c_str()); return 1; }
+
+    const size_t kShardBytes = 16u << 20;
+    unsigned n = std::min<unsigned>(workerCount(), (unsigned)games);
+    std::vector<std::unique_ptr<ShardWriter>> writers(n);
+    std::vector<std::unique_ptr<DatasetRecorder>> recorders(n);
+    std::vector<std::unique_ptr<Game>> boards(n);
+
+    sf::Clock clock;
+    // Задача w — своя доска, свой писатель шардов и каждая n-я партия;
+    // всё это создаётся в потоке задачи (первое касание)
+    parallelFor((int)n, [&](int w, int) {
+        writers[w] = std::make_unique<ShardWriter>(prefix + "-w" + std::to_string(w), p.W, p.H, kShardBytes);
+        recorders[w] = std::make_unique<DatasetRecorder>(p.W, p.H, *writers[w]);
+        boards[w] = std::make_unique<Game>(p.W, p.H, p.MINES,
+            std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        for (int gameNo = w; gameNo < games; gameNo += (int)n) {
+            std::uint32_t seed = mixSeed((std::uint64_t)gameNo);
+            std::unique_ptr<IBotPolicy> bot = makeBotPolicy(botName, seed);
+            playGame(*boards[w], *bot, seed, -1, -1, recorders[w].get());
+        }
+        writers[w]->close();
+    });
+
+    std::uint64_t records = 0, bytes = 0;
+    bool ok = true;
+    for (unsigned w = 0; w < n; w++) {
+        records += recorders[w]->records;
+        bytes += writers[w]->written();
+        ok = ok && writers[w]->ok();
+    }
+    float sec = clock.getElapsedTime().asSeconds();
+    AsyncIoService::instance().drain(); // done шардов приходит раньше счётчиков сервиса
+    AsyncIoService::Metrics io = AsyncIoService::instance().metrics();
+    std::printf("%d games, %llu positions, %.1f MB in %.1f s (%.1f MB/s)%s\n",
+                games, (unsigned long long)records, bytes / 1048576.0, sec,
+                sec > 0 ? bytes / 1048576.0 / sec : 0.0, ok ? "" : " — WRITE ERRORS");
+    std::printf("  io (%s): %llu writes in %llu batches, %llu from registered buffers, %llu fsync, "
+                "max queue %zu, latency avg %.2f ms, max %.2f ms\n",
+                io.backend == AsyncIoService::Backend::IoUring ? "io_uring" : "threads",
+                (unsigned long long)io.completed, (unsigned long long)io.batches,
+                (unsigned long long)io.fixedWrites, (unsigned long long)io.syncs,
+                io.maxQueueDepth, io.avgLatencyMs, io.maxLatencyMs);
+    return ok ? 0 : 1;
+}
+
+// OFFLINE MODE: проверка архива повторов на всех ядрах
+// sapper --validate-replays <file> [maxReported]
+
+static int runReplayValidation(int argc, char** argv) {
+    if (argc < 3) {
+        std::printf("usage: --validate-replays <file> [maxReported]\n");
+        return 1;
+    }
+    size_t maxReported = argc > 3 ? (size_t)std::max(0, std::atoi(argv[3])) : 20;
+
+    std::ifstream f(argv[2], std::ios::binary);
+    if (!f) { std::printf("cannot open %s\n", argv[2]); return 1; }
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    // Границы строк [begin, end); пустые строки пропускаем
+    std::vector<std::pair<size_t, size_t>> lines;
+    for (size_t pos = 0; pos < data.size();) {
+        size_t e = data.find('\n', pos);
+        if (e == std::string::npos) e = data.size();
+        if (e > pos) lines.push_back({pos, e});
+        pos = e + 1;
+    }
+
+    struct Failure { size_t line; unsigned flags; int badAction; };
+    struct Chunk {
+        std::uint64_t ok = 0, assisted = 0, rejected = 0;
+        std::vector<Failure> failures;
+    };
+    const int kChunk = 4096;
+    int chunks = (int)((lines.size() + kChunk - 1) / kChunk);
+    std::vector<Chunk> results(chunks);
+    std::vector<ReplayValidator::GameCache> games(workerCount());
+
+    sf::Clock clock;
+    parallelFor(chunks, [&](int c, int w) {
+        Replay r;
+        size_t from = (size_t)c * kChunk, to = std::min(lines.size(), from + kChunk);
+        for (size_t k = from; k < to; k++) {
+            ReplayValidator::Result res;
+            if (!r.parse(data.data() + lines[k].first, data.data() + lines[k].second))
+                res.flags = ReplayValidator::Corrupt;
+            else
+                res = ReplayValidator::validate(r, games[w]);
+
+            if (ReplayValidator::cheated(res.flags)) {
+                results[c].rejected++;
+                if (results[c].failures.size() < maxReported)
+                    results[c].failures.push_back({k + 1, res.flags, res.badAction});
+            } else {
+                results[c].ok++;
+                if (res.flags & ReplayValidator::Assisted) results[c].assisted++;
+            }
+        }
+    });
+    float sec = clock.getElapsedTime().asSeconds();
+
+    Chunk total;
+    for (const Chunk& c : results) {
+        total.ok += c.ok;
+        total.assisted += c.assisted;
+        total.rejected += c.rejected;
+        for (const Failure& fl : c.failures)
+            if (total.failures.size() < maxReported) total.failures.push_back(fl);
+    }
+
+    static const char* names[] = {"corrupt", "illegal-action", "result-mismatch",
+                                  "time-mismatch", "superhuman", "assisted", "oversized"};
+    for (const Failure& fl : total.failures) {
+        std::printf("  line %zu:", fl.line);
+        for (int b = 0; b < 7; b++)
+            if (fl.flags & (1u << b)) std::printf(" %s", names[b]);
+        if (fl.badAction >= 0) std::printf(" (action %d)", fl.badAction);
+        std::printf("\n");
+    }
+    std::printf("%zu replays: %llu valid (%llu hint-assisted), %llu rejected; %.2f s, %.0f replays/s\n",
+                lines.size(), (unsigned long long)total.ok, (unsigned long long)total.assisted,
+                (unsigned long long)total.rejected, sec, sec > 0 ? lines.size() / sec : 0.0);
+    return total.rejected ? 2 : 0;
+}
+
+// OFFLINE MODE: архив сжатых позиций из партий бота
+// sapper --archive-boards <file> [preset] [games] [bot]
+// Файл: "MSBA", затем записи (varint длины + сжатое поле). Из каждой партии
+// берётся одна случайная позиция (выборка с резервуаром по ходам).
+
+static int runBoardArchive(int argc, char** argv) {
+    if (argc < 3) {
+        std::printf("usage: --archive-boards <file> [preset] [games] [bot]\n");
+        return 1;
+    }
+    std::string path = argv[2];
+    GamePreset p = parsePresets(argc > 3 ? argv[3] : "3").front();
+    int games = argc > 4 ? std::max(1, std::atoi(argv[4])) : 10000;
+    std::string botName = argc > 5 ? argv[5] : "solver";
+    if (!makeBotPolicy(botName, 0)) { std::printf("unknown bot %s\n", botName.c_str()); return 1; }
+
+    struct Sampler final : ISimObserver {
+        std::mt19937 rng;
+        int seen = 0;
+        BoardPlanes picked;
+        void beforeMove(const Game& g, const BotMove&) override {
+            if (rng() % (unsigned)++seen == 0) picked = BoardPlanes::capture(g);
+        }
+    };
+
+    unsigned n = std::min<unsigned>(workerCount(), (unsigned)games);
+    std::vector<std::vector<BoardPlanes>> boards(n);
+    std::vector<std::vector<unsigned char>> blobs(n);
+    std::vector<std::vector<size_t>> sizes(n);
+    parallelFor((int)n, [&](int w, int) {
+        Game game(p.W, p.H, p.MINES, std::make_unique<DefaultCellFactory>(),
+                  std::make_unique<DefaultBoardGenerator>());
+        BoardCodec::Workspace ws;
+        std::vector<unsigned char> one;
+        for (int gameNo = w; gameNo < games; gameNo += (int)n) {
+            std::uint32_t seed = mixSeed((std::uint64_t)gameNo);
+            std::unique_ptr<IBotPolicy> bot = makeBotPolicy(botName, seed);
+            Sampler s;
+            s.rng.seed(seed);
+            playGame(game, *bot, seed, -1, -1, &s);
+            if (!s.seen) s.picked = BoardPlanes::capture(game); // партия в один ход
+
+            one.clear();
+            BoardCodec::encode(s.picked, one, ws);
+            std::uint32_t len = (std::uint32_t)one.size();
+            while (len >= 0x80) { blobs[w].push_back((unsigned char)(len | 0x80)); len >>= 7; }
+            blobs[w].push_back((unsigned char)len);
+            blobs[w].insert(blobs[w].end(), one.begin(), one.end());
+            sizes[w].push_back(one.size());
+            boards[w].push_back(std::move(s.picked));
+        }
+    });
+
+    AsyncIoService::Request req;
+    req.path = path;
+    req.mode = AsyncIoService::Mode::Truncate;
+    req.data = {'M', 'S', 'B', 'A'};
+    for (const std::vector<unsigned char>& b : blobs) req.data.insert(req.data.end(), b.begin(), b.end());
+    size_t fileBytes = req.data.size();
+    if (!AsyncIoService::instance().submitAndWait(std::move(req))) {
+        std::printf("cannot write %s\n", path.c_str());
+        return 1;
+    }
+
+    // Проверка: всё раскодированное совпадает с исходным, и скорость декодера
+    BoardPlanes out;
+    BoardCodec::Workspace ws;
+    BoardVerifier verifier;
+    int mismatches = 0, invalid = 0;
+    std::uint64_t cellsDecoded = 0;
+    sf::Clock clock;
+    for (int pass = 0; pass == 0 || clock.getElapsedTime().asSeconds() < 1.0f; pass++) {
+        for (unsigned w = 0; w < n; w++) {
+            const unsigned char* c = blobs[w].data();
+            const unsigned char* end = c + blobs[w].size();
+            for (size_t k = 0; k < sizes[w].size(); k++) {
+                while (*c & 0x80) c++;
+                c++;
+                bool ok = BoardCodec::decode(c, c + sizes[w][k], out, ws);
+                if (pass == 0) {
+                    const BoardPlanes& in = boards[w][k];
+                    if (!ok || out.mine != in.mine || out.opened != in.opened || out.flag != in.flag)
+                        mismatches++;
+                    else if (!verifier.verify(out).ok())
+                        invalid++;
+                }
+                c += sizes[w][k];
+                cellsDecoded += (std::uint64_t)p.W * p.H;
+            }
+            if (c != end) mismatches++;
+        }
+        if (pass >= 1000) break;
+    }
+    float sec = clock.getElapsedTime().asSeconds();
+
+    // Информационная граница для одной плоскости мин: log2 C(W*H, MINES)
+    double cells = (double)p.W * p.H;
+    double mineBound = (std::lgamma(cells + 1) - std::lgamma(p.MINES + 1.0)
+                        - std::lgamma(cells - p.MINES + 1)) / std::log(2.0);
+    double avgBits = (fileBytes - 4) * 8.0 / games;
+    std::printf("%d boards %dx%d/%d: %.1f bits/board (raw 3 planes %.0f bits, mine plane bound %.1f bits)\n",
+                games, p.W, p.H, p.MINES, avgBits, cells * 3, mineBound);
+    std::printf("decode: %.0f Mcells/s on one core, %d mismatches, %d boards failed verification\n",
+                sec > 0 ? cellsDecoded / 1e6 / sec : 0.0, mismatches, invalid);
+    return mismatches || invalid ? 2 : 0;
+}
+
+// OFFLINE MODE: сравнение хранилищ поля
+// sapper --bench-storage [WxHxM] [seed]
+// Один и тот же сценарий на каждом хранилище: первый клик в центр, затем
+// обход всех клеток в псевдослучайном порядке — мину помечаем флагом,
+// остальное открываем (до победы). Для полей до 4M клеток тот же сценарий
+// играет Game — правила те же (PlaneBoard на dense), разница во времени —
+// цена объектов клеток. Хеш видимого поля у всех должен совпасть.
+
+static int runStorageBench(int argc, char** argv) {
+    GamePreset p = parsePresets(argc > 2 ? argv[2] : "4000x4000x2560000").front();
+    std::uint32_t seed = argc > 3 ? (std::uint32_t)std::strtoul(argv[3], nullptr, 10) : 1;
+    const size_t cells = (size_t)p.W * p.H;
+    if (p.MINES >= (long long)cells - 9) { std::printf("too many mines\n"); return 1; }
+
+    // Обход k -> (k*step) mod N, step взаимно прост с N
+    size_t step = 2654435761u % cells;
+    auto gcd = [](size_t a, size_t b) { while (b) { size_t t = a % b; a = b; b = t; } return a; };
+    while (step == 0 || gcd(step, cells) != 1) step++;
+
+    auto fnv = [](std::uint64_t h, unsigned char c) { return (h ^ c) * 1099511628211ull; };
+    auto msSince = [](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+    };
+
+    std::printf("%dx%d, %d mines, seed %u\n", p.W, p.H, p.MINES, (unsigned)seed);
+    std::printf("%-8s %10s %10s %12s %10s %10s  %s\n",
+                "storage", "MB", "bytes/cell", "1st click ms", "play ms", "Mcells/s", "hash");
+
+    std::uint64_t reference = 0;
+    bool mismatch = false;
+    auto report = [&](const char* name, double mb, double firstMs, double playMs, std::uint64_t hash, bool won) {
+        if (!reference) reference = hash;
+        mismatch = mismatch || hash != reference || !won;
+        if (mb > 0) std::printf("%-8s %10.1f %10.2f", name, mb, mb * 1048576.0 / cells);
+        else        std::printf("%-8s %10s %10s", name, "-", "-");
+        std::printf(" %12.1f %10.1f %10.1f  %016llx%s\n", firstMs, playMs,
+                    cells / ((firstMs + playMs) * 1000.0), (unsigned long long)hash, won ? "" : " (not won)");
+    };
+
+    for (const char* name : {"dense", "bits", "tiles"}) {
+        PlaneBoard b(p.W, p.H, p.MINES, makeBoardStorage(name));
+        b.reseed(seed);
+        auto t0 = std::chrono::steady_clock::now();
+        b.reveal(p.W / 2, p.H / 2);
+        double firstMs = msSince(t0);
+        t0 = std::chrono::steady_clock::now();
+        for (size_t k = 0, i = 0; k < cells && !b.win && !b.gameOver; k++, i = (i + step) % cells) {
+            unsigned char c = b.cells().get(i);
+            if (c & (IBoardStorage::kOpened | IBoardStorage::kFlag)) continue;
+            if (c & IBoardStorage::kMine) b.toggleFlag((int)(i % p.W), (int)(i / p.W));
+            else                          b.reveal((int)(i % p.W), (int)(i / p.W));
+        }
+        double playMs = msSince(t0);
+        std::uint64_t h = 14695981039346656037ull;
+        for (int y = 0; y < p.H; y++)
+            for (int x = 0; x < p.W; x++) h = fnv(h, b.visible(x, y));
+        report(name, b.cells().bytes() / 1048576.0, firstMs, playMs, h, b.win);
+    }
+
+    if (cells <= (size_t)4 << 20) {
+        Game g(p.W, p.H, p.MINES, std::make_unique<DefaultCellFactory>(), makeBoardGenerator(0));
+        g.boardGenerator->reseed(seed);
+        auto t0 = std::chrono::steady_clock::now();
+        g.leftClickCell(p.W / 2, p.H / 2);
+        double firstMs = msSince(t0);
+        t0 = std::chrono::steady_clock::now();
+        for (size_t k = 0, i = 0; k < cells && !g.win && !g.gameOver; k++, i = (i + step) % cells) {
+            const Cell& c = g.field[i / p.W][i % p.W];
+            if (c.state->isOpen() || c.state->isFlagged()) continue;
+            if (c.content->isMine()) g.rightClickCell((int)(i % p.W), (int)(i / p.W));
+            else                     g.leftClickCell((int)(i % p.W), (int)(i / p.W));
+        }
+        double playMs = msSince(t0);
+        std::uint64_t h = 14695981039346656037ull;
+        for (int y = 0; y < p.H; y++)
+            for (int x = 0; x < p.W; x++) h = fnv(h, visibleCode(g.field[y][x]));
+        report("game", 0.0, firstMs, playMs, h, g.win);
+    }
+
+    if (mismatch) std::printf("MISMATCH between storages\n");
+    return mismatch ? 2 : 0;
+}
+
+// OFFLINE MODE: файл поля PlaneBoard
+// sapper --board-file create <file> [WxHxM] [seed] — новое поле, первый клик в центр
+// sapper --board-file open <file> [moves] [seed] [trust] — открыть через mmap
+//   (со сверкой клеток, trust — без неё) и сделать moves ходов в случайные
+//   клетки (мину — флагом, иначе открыть); для сравнения то же поле читается
+//   в память целиком.
+
+static int runBoardFile(int argc, char** argv) {
+    if (argc < 4 || (std::string(argv[2]) != "create" && std::string(argv[2]) != "open")) {
+        std::printf("usage: --board-file create <file> [WxHxM] [seed]\n"
+                    "       --board-file open <file> [moves] [seed] [trust]\n");
+        return 1;
+    }
+    std::string path = argv[3];
+    auto msSince = [](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+    };
+
+    if (std::string(argv[2]) == "create") {
+        GamePreset p = parsePresets(argc > 4 ? argv[4] : "20000x20000x60000000").front();
+        std::uint32_t seed = argc > 5 ? (std::uint32_t)std::strtoul(argv[5], nullptr, 10) : 1;
+        PlaneBoard b(p.W, p.H, p.MINES, makeBoardStorage("dense"));
+        b.reseed(seed);
+        auto t0 = std::chrono::steady_clock::now();
+        b.reveal(p.W / 2, p.H / 2);
+        double genMs = msSince(t0);
+        t0 = std::chrono::steady_clock::now();
+        if (!saveBoardFile(b, path)) { std::printf("write to %s failed\n", path.c_str()); return 1; }
+        std::printf("%dx%d, %d mines: generated in %.0f ms (%zu opened), saved in %.0f ms, %.1f MB\n",
+                    p.W, p.H, p.MINES, genMs, b.openedCount, msSince(t0),
+                    (kBoardFileHeader + (double)p.W * p.H) / 1048576.0);
+        return 0;
+    }
+
+    int moves = argc > 4 ? std::max(0, std::atoi(argv[4])) : 1000;
+    std::uint32_t seed = argc > 5 ? (std::uint32_t)std::strtoul(argv[5], nullptr, 10) : 1;
+
+    bool trusted = argc > 6 && std::string(argv[6]) == "trust";
+
+    std::string err;
+    auto t0 = std::chrono::steady_clock::now();
+    std::unique_ptr<PlaneBoard> b = loadBoardFile(path, err, trusted);
+    double openMs = msSince(t0);
+    if (!b) { std::printf("%s: %s\n", path.c_str(), err.c_str()); return 1; }
+    const MappedBoardStorage& st = static_cast<const MappedBoardStorage&>(b->cells());
+    double fileMb = st.mappedBytes() / 1048576.0;
+    std::printf("%dx%d, %d mines: mapped%s in %.2f ms, %.1f of %.1f MB in page cache\n",
+                b->W, b->H, b->MINES, trusted || b->firstClick ? "" : " and verified", openMs,
+                st.bytes() / 1048576.0, fileMb);
+
+    std::mt19937 rng(mixSeed(seed)); // не то же зерно, что расставило мины
+    size_t before = b->openedCount;
+    t0 = std::chrono::steady_clock::now();
+    for (int m = 0; m < moves && !b->gameOver && !b->win; m++) {
+        int x = (int)(rng() % (unsigned)b->W), y = (int)(rng() % (unsigned)b->H);
+        unsigned char c = b->cells().get(b->index(x, y));
+        if (c & (IBoardStorage::kOpened | IBoardStorage::kFlag)) continue;
+        if (c & IBoardStorage::kMine) b->toggleFlag(x, y);
+        else                          b->reveal(x, y);
+    }
+    std::printf("%d moves in %.1f ms (%zu cells opened), %.1f MB in page cache\n",
+                moves, msSince(t0), b->openedCount - before, st.bytes() / 1048576.0);
+
+    // Для сравнения: чтение всего файла в обычную память
+    t0 = std::chrono::steady_clock::now();
+    std::ifstream f(path, std::ios::binary);
+    std::vector<unsigned char> all((size_t)(fileMb * 1048576.0 + 0.5));
+    f.read((char*)all.data(), (std::streamsize)all.size());
+    std::printf("full read for comparison: %.0f ms, %.1f MB\n", msSince(t0), all.size() / 1048576.0);
+    return 0;
+}
+
+// OFFLINE MODE: размещение памяти
+// sapper --bench-memory [WxHxM] [games]
+// 1) Первый клик на большом редком поле PlaneBoard (расстановка, числа и
+//    проём почти на всё поле) с обычными, прозрачными и явными большими
+//    страницами. 2) Партии бота на всех ядрах: доски созданы главным потоком
+//    и потоки не закреплены — против досок, созданных в своих закреплённых потоках.
+
+static int runMemoryBench(int argc, char** argv) {
+    GamePreset p = parsePresets(argc > 2 ? argv[2] : "8000x8000x640000").front();
+    int games = argc > 3 ? std::max(1, std::atoi(argv[3])) : 2000;
+    auto msSince = [](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+    };
+
+#if defined(__linux__)
+    {
+        std::ifstream thp("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string mode;
+        std::getline(thp, mode);
+        std::printf("THP: %s\n", mode.empty() ? "unavailable" : mode.c_str());
+    }
+#endif
+    std::printf("board %dx%d, %d mines (%.0f MB dense)\n", p.W, p.H, p.MINES, (double)p.W * p.H / 1048576.0);
+    static const char* pageNames[] = {"4k pages", "THP", "hugetlb"};
+    double base = 0.0;
+    for (MemoryPlacement::Pages mode : {MemoryPlacement::Pages::Normal, MemoryPlacement::Pages::Transparent,
+                                        MemoryPlacement::Pages::Explicit}) {
+        long hugeBefore = anonHugePagesKb();
+        auto t0 = std::chrono::steady_clock::now();
+        auto storage = std::make_unique<DenseBoardStorage>(mode);
+        const DenseBoardStorage* dense = storage.get();
+        PlaneBoard b(p.W, p.H, p.MINES, std::move(storage));
+        b.reseed(1);
+        b.reveal(p.W / 2, p.H / 2);
+        double ms = msSince(t0);
+        if (base == 0.0) base = ms;
+        std::printf("  %-9s got %-9s %8.0f ms  x%.2f  %zu opened, %ld MB on huge pages\n",
+                    pageNames[(int)mode], pageNames[(int)dense->pages()], ms, base / ms, b.openedCount,
+                    (anonHugePagesKb() - hugeBefore) / 1024);
+    }
+
+    std::printf("simulator: %d expert games (solver bot), %u workers\n", games, workerCount());
+    GamePreset e = presetByDifficulty(3);
+    MemoryPlacement& placement = MemoryPlacement::instance();
+    bool pinBefore = placement.pinWorkers;
+    auto makeGame = [&] {
+        return std::make_unique<Game>(e.W, e.H, e.MINES,
+            std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+    };
+    double shared = 0.0;
+    for (int local = 0; local < 2; local++) {
+        placement.pinWorkers = local == 1;
+        unsigned n = workerCount();
+        std::vector<std::unique_ptr<Game>> boards(n);
+        if (!local)
+            for (auto& g : boards) g = makeGame(); // всё на узле главного потока
+        std::atomic<int> wins{0};
+        auto t0 = std::chrono::steady_clock::now();
+        parallelFor((int)n, [&](int w, int) {
+            if (!boards[w]) boards[w] = makeGame();
+            for (int g = w; g < games; g += (int)n) {
+                std::uint32_t seed = mixSeed((std::uint64_t)g);
+                SolverBot bot(seed);
+                wins += playGame(*boards[w], bot, seed).win;
+            }
+        });
+        double ms = msSince(t0);
+        if (!local) shared = ms;
+        std::printf("  %-24s %8.0f ms  %7.0f games/s  x%.2f  (%d won)\n",
+                    local ? "local + pinned workers" : "shared, unpinned", ms, games * 1000.0 / ms,
+                    shared / ms, wins.load());
+    }
+    placement.pinWorkers = pinBefore;
+    return 0;
+}
+
+// OFFLINE MODE: память подсистем
+// sapper [--memory-limit MB] --memory-report [WxHxM] [games]
+// Бот на решателе играет партии; после каждой — проверка предела памяти,
+// в конце — дерево memoryUsage в JSON.
+
+static int runMemoryReport(int argc, char** argv, size_t limit) {
+    GamePreset p = parsePresets(argc > 2 ? argv[2] : "1000x1000x150000").front();
+    int games = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+
+    Game game(p.W, p.H, p.MINES, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+    DefaultSolver solver;
+    std::mt19937 rng(1);
+    MemoryBudget budget(limit);
+    budget.addCache("async io pool", [] { return AsyncIoService::instance().trimPool(); });
+    budget.addCache("solver", [&] { return solver.releaseCaches(); });
+    auto usage = [&] {
+        return processMemoryUsage({game.memoryUsage(), solver.memoryUsage(), AsyncIoService::instance().memoryUsage()});
+    };
+
+    for (int g = 0; g < games; g++) {
+        game.boardGenerator->reseed(mixSeed((std::uint64_t)g));
+        game.resetField();
+        game.leftClickCell(p.W / 2, p.H / 2);
+        Deduction d;
+        while (!game.gameOver && !game.win) {
+            if (solver.nextMove(game, d)) {
+                if (d.mine) game.rightClickCell(d.x, d.y);
+                else        game.leftClickCell(d.x, d.y);
+                continue;
+            }
+            int i = randomUnknownCell(game, rng, false);
+            if (i < 0) break;
+            game.leftClickCell(i % p.W, i / p.W);
+        }
+        size_t freed = budget.enforce(usage());
+        std::fprintf(stderr, "game %d: %s, %d opened%s\n", g + 1, game.win ? "won" : "lost", game.openedCount,
+                     freed ? (", evicted " + std::to_string(freed >> 10) + " KB").c_str() : "");
+    }
+    std::printf("%s\n", usage().toJson().c_str());
+    std::string text;
+    usage().describe(text);
+    std::fprintf(stderr, "%s", text.c_str());
+    return 0;
+}
+
+// OFFLINE MODE: рендереры без окна
+// sapper --bench-render [WxHxM,...] [frames] [out.json]
+// Синтетические состояния поля (доля открытых клеток и флагов на минах)
+// рисуются каждым рендерером в sf::RenderTexture. Замеряется построение
+// кадра на CPU (вызов render), кадр целиком (с display), вызовы draw,
+// вершины и загрузка текстур. Первый кадр — отдельно: шейдерный рендерер
+// загружает в нём всю текстуру состояния.
+
+// Поле с заданной долей открытых безопасных клеток и флагов на минах
+static void makeSyntheticBoard(Game& game, double openShare, double flagShare, std::uint32_t seed) {
+    game.boardGenerator->reseed(seed);
+    game.resetField();
+    if (openShare <= 0.0) return;
+    std::mt19937 rng(seed);
+    game.leftClickCell(game.W / 2, game.H / 2);
+
+    std::vector<int> safe, mines;
+    for (int i = 0; i < game.W * game.H; i++) {
+        const Cell& c = game.field[i / game.W][i % game.W];
+        if (!c.state->isOpen()) (c.content->isMine() ? mines : safe).push_back(i);
+    }
+    std::shuffle(safe.begin(), safe.end(), rng);
+    std::shuffle(mines.begin(), mines.end(), rng);
+    int openTarget = (int)(openShare * (game.W * game.H - game.MINES));
+    for (size_t k = 0; k < safe.size() && game.openedCount < openTarget; k++)
+        game.leftClickCell(safe[k] % game.W, safe[k] / game.W);
+    for (size_t k = 0; k < (size_t)(flagShare * (double)mines.size()) && !game.win; k++)
+        game.rightClickCell(mines[k] % game.W, mines[k] / game.W);
+}
+
+static int runRenderBench(int argc, char** argv) {
+    std::vector<GamePreset> presets;
+    std::string list = argc > 2 ? argv[2] : "9x9x10,30x16x99,100x100x1500,300x300x13500";
+    for (size_t from = 0; from <= list.size();) {
+        size_t comma = std::min(list.find(',', from), list.size());
+        presets.push_back(parsePresets(list.substr(from, comma - from)).front());
+        from = comma + 1;
+    }
+    int frames = argc > 3 ? std::max(1, std::atoi(argv[3])) : 60;
+    std::string outPath = argc > 4 ? argv[4] : "render_bench.json";
+
+    sf::Font font;
+    if (!loadUiFont(font)) {
+        std::printf("no font\n");
+        return 1;
+    }
+    auto theme = ThemeFactory::makeDefault();
+    Layout layout;
+    layout.resize(1280, 960, 1.0f);
+    sf::RenderTexture target;
+    if (!target.create((unsigned)layout.WINDOW_W, (unsigned)layout.WINDOW_H)) {
+        std::printf("cannot create %dx%d render texture\n", layout.WINDOW_W, layout.WINDOW_H);
+        return 1;
+    }
+
+    UiWidgets ui;
+    ui.status = sf::Text("", font);
+    ui.restartText = sf::Text("Restart", font);
+    ui.menuText = sf::Text("Menu", font);
+    ui.minesIndicator = sf::Text("", font);
+    ui.timerText = sf::Text("", font);
+    placeHud(layout, *theme, ui);
+
+    const struct { double open, flags; } states[] = {{0.0, 0.0}, {0.5, 0.25}, {0.95, 1.0}};
+    std::string json = "[";
+    std::printf("%-8s %-16s %5s %5s %9s %9s %9s %7s %9s %10s\n", "renderer", "board", "open", "flags",
+                "first ms", "build ms", "frame ms", "draws", "vertices", "1st upload");
+    for (const GamePreset& p : presets) {
+        Game game(p.W, p.H, p.MINES, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        layout.recompute(game);
+        for (const char* kind : {"sfml", "shader"}) {
+            std::unique_ptr<IRenderer> renderer;
+            if (std::string(kind) == "sfml") renderer = std::make_unique<SfmlRenderer>(font, *theme);
+            else renderer = ShaderRenderer::create(font, *theme, layout.CELL);
+            if (!renderer) {
+                std::printf("%-8s (shaders unavailable)\n", kind);
+                continue;
+            }
+            for (const auto& st : states) {
+                makeSyntheticBoard(game, st.open, st.flags, 1);
+                auto t0 = std::chrono::steady_clock::now();
+                renderer->render(target, game, layout, ui);
+                target.display();
+                double firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                size_t firstUpload = renderer->lastFrameStats().uploadedBytes;
+
+                double buildSum = 0.0, frameSum = 0.0;
+                for (int f = 0; f < frames; f++) {
+                    auto f0 = std::chrono::steady_clock::now();
+                    renderer->render(target, game, layout, ui);
+                    auto f1 = std::chrono::steady_clock::now();
+                    target.display();
+                    auto f2 = std::chrono::steady_clock::now();
+                    buildSum += std::chrono::duration<double, std::milli>(f1 - f0).count();
+                    frameSum += std::chrono::duration<double, std::milli>(f2 - f0).count();
+                }
+                RenderStats rs = renderer->lastFrameStats();
+                char board[48], row[512];
+                std::snprintf(board, sizeof(board), "%dx%dx%d", p.W, p.H, p.MINES);
+                std::printf("%-8s %-16s %4.0f%% %4.0f%% %9.2f %9.3f %9.3f %7d %9zu %10zu\n", kind, board,
+                            st.open * 100, st.flags * 100, firstMs, buildSum / frames, frameSum / frames,
+                            rs.drawCalls, rs.vertices, firstUpload);
+                std::snprintf(row, sizeof(row),
+                              "%s\n{\"renderer\":\"%s\",\"board\":\"%s\",\"cell\":%d,\"open\":%.2f,\"flags\":%.2f,"
+                              "\"frames\":%d,\"first_ms\":%.3f,\"build_ms\":%.4f,\"frame_ms\":%.4f,"
+                              "\"draw_calls\":%d,\"vertices\":%zu,\"uploaded_bytes\":%zu,\"first_uploaded_bytes\":%zu}",
+                              json.size() > 1 ? "," : "", kind, board, layout.CELL, st.open, st.flags, frames,
+                              firstMs, buildSum / frames, frameSum / frames, rs.drawCalls, rs.vertices,
+                              rs.uploadedBytes, firstUpload);
+                json += row;
+            }
+        }
+    }
+    json += "\n]\n";
+
+    AsyncIoService::Request r;
+    r.path = outPath;
+    r.data.assign(json.begin(), json.end());
+    r.mode = AsyncIoService::Mode::Truncate;
+    if (!AsyncIoService::instance().submitAndWait(std::move(r))) {
+        std::printf("cannot write %s\n", outPath.c_str());
+        return 1;
+    }
+    std::printf("-> %s\n", outPath.c_str());
+    return 0;
+}
+
+// OFFLINE MODE: повтор в видео (без окна)
+// sapper --export-video <replays> <out.y4m|out.ppm> [line] [fps] [cell]
+// line — номер повтора в файле (с 1). Y4M понимают ffmpeg, mpv и x264.
+
+static int runVideoExport(int argc, char** argv) {
+    if (argc < 4) {
+        std::printf("usage: --export-video <replays> <out.y4m|out.ppm> [line] [fps] [cell]\n");
+        return 1;
+    }
+    int want = argc > 4 ? std::max(1, std::atoi(argv[4])) : 1;
+    ReplayVideoExporter::Options o;
+    if (argc > 5) o.fps = std::max(1, std::atoi(argv[5]));
+    if (argc > 6) o.cell = std::max(1, std::atoi(argv[6]));
+    std::string out = argv[3];
+    o.y4m = !(out.size() >= 4 && out.compare(out.size() - 4, 4, ".ppm") == 0);
+
+    std::ifstream f(argv[2]);
+    if (!f) { std::printf("cannot open %s\n", argv[2]); return 1; }
+    std::string line;
+    for (int n = 0; n < want && std::getline(f, line);) if (!line.empty()) n++;
+    Replay r;
+    if (line.empty() || !r.parse(line.data(), line.data() + line.size())) {
+        std::printf("no valid replay at line %d\n", want);
+        return 1;
+    }
+
+    auto theme = ThemeFactory::makeDefault();
+    ReplayVideoExporter::Report rep = ReplayVideoExporter::run(r, *theme, o, out);
+    if (!rep.ok) { std::printf("write to %s failed\n", out.c_str()); return 1; }
+    std::printf("%d frames %dx%d @ %d fps (%.1f s of video): %.2f s, %.0f frames/s, %.1f MB\n",
+                rep.frames, rep.width, rep.height, o.fps, (double)rep.frames / o.fps, rep.seconds,
+                rep.seconds > 0 ? rep.frames / rep.seconds : 0.0, rep.bytes / 1048576.0);
+    return 0;
+}
+
+// OFFLINE MODE: самопроверка на неправильных и враждебных входах
+// sapper --self-test — каждая проверка печатается; код возврата 1, если
+// какая-то не прошла. Имеет смысл собирать с -fsanitize=address,undefined.
+
+// Поле, где у открытого числа рядом больше закрытых клеток, чем оно само,
+// и на них флагов больше числа (игрок ошибся)
+static bool overflagNumber(Game& game) {
+    for (int i = 0; i < game.W * game.H; i++) {
+        int x = i % game.W, y = i / game.W;
+        const Cell& c = game.field[y][x];
+        if (!c.state->isOpen() || c.content->number() <= 0) continue;
+        std::vector<int> closed;
+        game.forEachNeighbor(x, y, [&](int nx, int ny, int n) {
+            if (!game.field[ny][nx].state->isOpen()) closed.push_back(n);
+        });
+        if ((int)closed.size() <= c.content->number()) continue;
+        for (int n : closed) game.rightClickCell(n % game.W, n / game.W);
+        return true;
+    }
+    return false;
+}
+
+static int runSelfTest(int, char**) {
+    int failed = 0;
+    auto check = [&](const char* name, bool ok) {
+        std::printf("%-52s %s\n", name, ok ? "ok" : "FAILED");
+        if (!ok) failed++;
+    };
+
+    {
+        // Выводы по-прежнему в пределах поля и только для закрытых клеток
+        bool found = false, sane = true;
+        for (std::uint32_t seed = 1; seed < 64 && !found; seed++) {
+            Game game(16, 16, 40, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+            game.boardGenerator->reseed(seed);
+            game.leftClickCell(8, 8);
+            if (game.gameOver || !overflagNumber(game)) continue;
+            found = true;
+            std::vector<Deduction> out;
+            LocalPatternMatcher patterns;
+            patterns.collect(game, out);
+            Deduction d;
+            DefaultSolver solver;
+            if (solver.nextMove(game, d)) out.push_back(d);
+            for (const Deduction& e : out)
+                sane = sane && e.x >= 0 && e.x < game.W && e.y >= 0 && e.y < game.H
+                       && !game.field[e.y][e.x].state->isOpen();
+        }
+        check("patterns: over-flagged number", found && sane);
+    }
+
+    {
+        // Это поле после первого клика: в фронтире компонента из 90 клеток
+        Game game(60, 60, 300, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        game.boardGenerator->reseed(1);
+        game.leftClickCell(30, 30);
+        std::vector<Deduction> out;
+        std::vector<CellOdds> odds;
+        ExactFrontierSolver().analyze(game, out, &odds);
+        check("exact solver: frontier component over 32 cells",
+              game.frontierClosed.size() > (size_t)BitSlicedEnumerator::kMaxUnknowns && !game.gameOver);
+    }
+
+    {
+        // Без мин переносить нечего — генератор не должен делить на ноль
+        Game game(10, 10, 0, std::make_unique<DefaultCellFactory>(), std::make_unique<TargetBbbvBoardGenerator>(5));
+        game.leftClickCell(5, 5);
+        check("3BV generator: board without mines", game.win);
+    }
+
+    {
+        // Враждебные строки повторов: отказ, а не вечный цикл, деление на ноль или bad_alloc
+        const char* lines[] = {
+            "9 9 80 0 1 0 1.0 0",              // мин больше, чем W*H-9
+            "9 9 10 0 1 0 1.0 999999999999",   // действий больше, чем влезает в строку
+            "9 9 0 5 1 0 1.0 0",               // цель 3BV без мин
+            "9 9 10 500 1 0 1.0 0",            // 3BV больше безопасных клеток
+            "9 9 10 0 1 0 1.0 2 L 1 1 0.5",    // действий меньше заявленного
+            "9 9 10 0 4294967296 0 1.0 0",     // зерно шире uint32
+            "9 9 10 0 -1 0 1.0 0",             // зерно со знаком
+        };
+        bool rejected = true;
+        for (const char* l : lines) {
+            Replay r;
+            rejected = rejected && !r.parse(l, l + std::strlen(l));
+        }
+        Replay ok;
+        const char* good = "9 9 10 0 4000000000 0 1.0 1 L 4 4 0.5";
+        check("replays: hostile lines rejected", rejected && ok.parse(good, good + std::strlen(good))
+                                                 && ok.seed == 4000000000u);
+    }
+
+    {
+        // Файл поля до первого клика: лишние мины или заполненные клетки — отказ
+        const std::string path = "sapper_selftest.mspb";
+        PlaneBoard b(9, 9, 10, makeBoardStorage("dense"));
+        bool saved = saveBoardFile(b, path);
+        std::string err;
+        bool clean = saved && loadBoardFile(path, err) != nullptr;
+        auto patched = [&](size_t offset, unsigned char byte) {
+            std::vector<unsigned char> data(kBoardFileHeader + 81);
+            std::ifstream(path, std::ios::binary).read((char*)data.data(), (std::streamsize)data.size());
+            data[offset] = byte;
+            std::string bad = path + ".bad";
+            std::ofstream(bad, std::ios::binary).write((const char*)data.data(), (std::streamsize)data.size());
+            bool loaded = loadBoardFile(bad, err) != nullptr;
+            std::remove(bad.c_str());
+            return loaded;
+        };
+        bool rejected = !patched(16, 75)                                        // 75 мин на 81 клетку
+                        && !patched(kBoardFileHeader + 40, IBoardStorage::kMine)
+                        && !patched(kBoardFileHeader + 40, IBoardStorage::kOpened);
+        std::remove(path.c_str());
+        check("board files: bad first-click boards rejected", clean && rejected);
+    }
+
+    {
+        // Файл поля после первого клика: счётчики и клетки сверяются
+        const std::string path = "sapper_selftest.mspb";
+        PlaneBoard b(9, 9, 10, makeBoardStorage("dense"));
+        b.reseed(3);
+        b.reveal(4, 4);
+        size_t mine = 0, closed = 0;
+        for (size_t i = 0; i < 81; i++) {
+            unsigned char c = b.cells().get(i);
+            if (c & IBoardStorage::kMine) mine = i;
+            else if (!(c & IBoardStorage::kOpened)) closed = i;
+        }
+        b.toggleFlag((int)(mine % 9), (int)(mine / 9));
+        bool saved = saveBoardFile(b, path);
+        std::string err;
+        bool clean = saved && loadBoardFile(path, err) != nullptr;
+        auto patched = [&](size_t offset, std::uint32_t value, bool trusted) {
+            std::vector<unsigned char> data(kBoardFileHeader + 81);
+            std::ifstream(path, std::ios::binary).read((char*)data.data(), (std::streamsize)data.size());
+            if (offset == 8) std::memcpy(&data[12], &value, 4); // W и H сразу
+            if (offset < kBoardFileHeader) std::memcpy(&data[offset], &value, 4);
+            else data[offset] = (unsigned char)value;
+            std::string bad = path + ".bad";
+            std::ofstream(bad, std::ios::binary).write((const char*)data.data(), (std::streamsize)data.size());
+            bool loaded = loadBoardFile(bad, err, trusted) != nullptr;
+            std::remove(bad.c_str());
+            return loaded;
+        };
+        std::uint32_t cell = b.cells().get(closed);
+        bool rejected = !patched(20, 4, false)                                   // победа без открытых клеток
+                        && !patched(24, (std::uint32_t)b.openedCount + 1, false)
+                        && !patched(kBoardFileHeader + closed, cell | IBoardStorage::kMine, false);
+        bool trusted = patched(20, 4, true);
+        bool huge = !patched(8, 65536, false) && err == "bad size";        // 65536x65536
+        std::remove(path.c_str());
+        check("board files: counters verified after first click", clean && rejected && trusted && huge);
+    }
+
+    {
+        // Game играет по правилам PlaneBoard, объекты клеток — представление:
+        // оно совпадает с голым PlaneBoard на другом хранилище. Сценарий
+        // --bench-storage на малом поле: до победы, затем с открытием мины
+        const int W = 30, H = 16, M = 99;
+        bool same = true, won = false, lost = false;
+        for (int round = 0; round < 2; round++) {
+            PlaneBoard b(W, H, M, makeBoardStorage("bits"));
+            Game g(W, H, M, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>(),
+                   makeBoardStorage("tiles"));
+            b.reseed(7);
+            g.boardGenerator->reseed(7);
+            b.reveal(W / 2, H / 2);
+            g.leftClickCell(W / 2, H / 2);
+            auto compare = [&] {
+                for (int j = 0; j < W * H; j++)
+                    same = same && b.visible(j % W, j / W) == visibleCode(g.field[j / W][j % W]);
+            };
+            for (int i = 0, k = 0; k < W * H; k++, i = (i + 37) % (W * H)) {
+                compare();
+                unsigned char c = b.cells().get((size_t)i);
+                if (c & (IBoardStorage::kOpened | IBoardStorage::kFlag)) continue;
+                bool flag = (c & IBoardStorage::kMine) && (round == 0 || k < W * H / 2);
+                if (flag) { b.toggleFlag(i % W, i / W); g.rightClickCell(i % W, i / W); }
+                else      { b.reveal(i % W, i / W);     g.leftClickCell(i % W, i / W); }
+            }
+            compare();
+            same = same && BoardVerifier().verify(g).ok();
+            if (round == 0) won = b.win && g.win;
+            else lost = b.gameOver && g.gameOver && g.explodedCell == (int)b.explodedAt
+                        && g.openedCount == W * H && g.flagsCount() == 0;
+        }
+        check("board storage: Game view follows PlaneBoard rules", same && won && lost);
+    }
+
+    {
+        // Пересчёт повторов: большие доски и недостижимый 3BV — без пересчёта,
+        // кэш игр — в пределах kCacheBytes
+        ReplayValidator::GameCache cache;
+        auto validate = [&](int w, int h, int m, int tgt) {
+            Replay r;
+            r.preset = {w, h, m};
+            r.target3bv = tgt;
+            r.seed = 5;
+            r.actions.push_back({'L', w / 2, h / 2, 0.5f});
+            return ReplayValidator::validate(r, cache).flags;
+        };
+        bool ok = (validate(4096, 4096, 100, 0) & ReplayValidator::Oversized)
+               && (validate(20, 20, 40, 300) & ReplayValidator::Oversized)
+               && !(validate(20, 20, 40, 60) & ReplayValidator::Oversized);
+        for (int side = 20; side <= 128; side += 4) validate(side, side, side, 0);
+        check("replays: validator limits", ok && cache.bytes() <= ReplayValidator::kCacheBytes);
+    }
+
+    {
+        // Поле из файла: чужой размер — ошибка, а не пустое поле; W*H — в int
+        BoardPlanes planes;
+        planes.resize(9, 9);
+        planes.mine[0] = 1;
+        Game game(10, 10, 1, std::make_unique<DefaultCellFactory>(), std::make_unique<FileBoardGenerator>(planes));
+        bool thrown = false;
+        try { game.leftClickCell(5, 5); } catch (const std::invalid_argument&) { thrown = true; }
+        unsigned char head[12] = {'M', 'S', 'M', 'B', 0, 0, 1, 0, 0, 0, 1, 0}; // 65536x65536
+        BoardPlanes big;
+        std::string err;
+        check("mine maps: size mismatch and overflow", thrown && !parseMineBinary(head, sizeof(head), big, err) && err == "bad size");
+    }
+
+    {
+        // Пачка: applied — только действия, изменившие поле
+        Game game(9, 9, 10, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        game.boardGenerator->reseed(2);
+        std::vector<GameAction> batch = {{GameAction::Reveal, 4, 4}, {GameAction::Reveal, 4, 4},
+                                         {GameAction::Flag, 20, 20}, {GameAction::Chord, 4, 4},
+                                         {GameAction::Flag, 0, 0}};
+        std::vector<ActionResult> res(batch.size());
+        size_t changed = 0;
+        BatchResult r = game.apply(batch, res.data());
+        for (ActionResult a : res) changed += a == ActionResult::Applied || a == ActionResult::Lost;
+        check("batch actions: applied counts board changes", r.applied == changed && changed >= 1
+                                                            && res[1] == ActionResult::Ignored);
+    }
+
+    {
+        // Проигрыш на chord: в событии Lost — взорвавшаяся мина, а не число
+        struct LostAt : IGameListener {
+            int x = -1, y = -1;
+            void onGameEvent(const Game&, const GameEvent& e) override {
+                if (e.type == GameEventType::Lost) { x = e.x; y = e.y; }
+            }
+        } lost;
+        bool tried = false, ok = true;
+        for (std::uint32_t seed = 1; seed < 64 && !tried; seed++) {
+            Game game(9, 9, 10, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+            game.boardGenerator->reseed(seed);
+            game.leftClickCell(4, 4);
+            for (int i = 0; i < 81 && !tried && !game.gameOver; i++) {
+                int x = i % 9, y = i / 9, number = game.field[y][x].content->number();
+                std::vector<int> safe, mines;
+                if (!game.field[y][x].state->isOpen() || number <= 0) continue;
+                game.forEachNeighbor(x, y, [&](int nx, int ny, int n) {
+                    if (game.field[ny][nx].state->isOpen()) return;
+                    (game.field[ny][nx].content->isMine() ? mines : safe).push_back(n);
+                });
+                if ((int)safe.size() < number) continue;
+                // Все флаги — мимо мин: chord откроет мину
+                for (int k = 0; k < number; k++) game.rightClickCell(safe[k] % 9, safe[k] / 9);
+                game.events.subscribe(&lost);
+                GameAction chord{GameAction::Chord, x, y};
+                game.apply(&chord, 1);
+                game.events.unsubscribe(&lost);
+                tried = true;
+                ok = game.gameOver && lost.x >= 0 && game.field[lost.y][lost.x].content->isMine()
+                     && std::count(mines.begin(), mines.end(), game.index(lost.x, lost.y)) == 1;
+            }
+        }
+        check("events: chord loss reports the exploded mine", tried && ok);
+    }
+
+    {
+        // Все закрытые клетки под флагами, партия не выиграна: боту ходить некуда
+        Game game(9, 9, 10, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        game.boardGenerator->reseed(3);
+        game.leftClickCell(4, 4);
+        for (int i = 0; i < 81; i++)
+            if (!game.field[i / 9][i % 9].state->isOpen()) game.rightClickCell(i % 9, i / 9);
+        SolverBot solverBot(1);
+        RandomGuessBot randomBot(1);
+        BotMove m;
+        bool none = !game.win && !game.gameOver && !solverBot.nextMove(game, m) && !randomBot.nextMove(game, m);
+        GameOutcome o = playGame(game, solverBot, 3);
+        check("bots: no move when every closed cell is flagged", none && o.moves > 0);
+    }
+
+    {
+        // Флаг до проёма: клетка у открытого нуля остаётся закрытой
+        Game game(16, 16, 30, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        game.boardGenerator->reseed(1);
+        game.rightClickCell(12, 3);
+        game.leftClickCell(11, 3);
+        bool sameAll = true;
+        for (int unflag = 0; unflag < 2; unflag++) {
+            if (unflag) game.rightClickCell(12, 3);
+            BoardPlanes planes = BoardPlanes::capture(game), back;
+            std::vector<unsigned char> data;
+            BoardCodec::encode(planes, data);
+            sameAll = sameAll && BoardCodec::decode(data.data(), data.data() + data.size(), back)
+                      && back.mine == planes.mine && back.opened == planes.opened && back.flag == planes.flag;
+        }
+        check("board codec: flags next to an opening round-trip", sameAll && !game.gameOver);
+    }
+
+    {
+        // Снимок до первого клика: мины — из заголовка, партия не выиграна
+        const std::string path = "sapper_selftest.mss";
+        Game game(16, 16, 40, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        game.rightClickCell(3, 3);
+        std::vector<unsigned char> data = makeSnapshot(game);
+        std::ofstream(path, std::ios::binary).write((const char*)data.data(), (std::streamsize)data.size());
+        Game loaded(9, 9, 10, std::make_unique<DefaultCellFactory>(), std::make_unique<DefaultBoardGenerator>());
+        bool ok = loadSnapshot(loaded, path);
+        std::remove(path.c_str());
+        ok = ok && loaded.W == 16 && loaded.MINES == 40 && loaded.firstClick && !loaded.win
+             && loaded.flagCount == 1 && loaded.field[3][3].state->isFlagged();
+        loaded.leftClickCell(8, 8);
+        check("snapshots: saved before the first click", ok && BoardPlanes::capture(loaded).mineCount() == 40);
+    }
+
+    {
+        // Запись пачкой: перезапись, дозаписи, тот же файл в двух группах
+        // одной пачки, fsync по интервалу и сразу (io_uring или потоковый способ)
+        AsyncIoService& io = AsyncIoService::instance();
+        const std::string a = "sapper_selftest_a.bin", b = "sapper_selftest_b.bin";
+        std::remove(b.c_str());
+        std::vector<unsigned char> big((size_t)200 << 10), want;
+        for (size_t i = 0; i < big.size(); i++) big[i] = (unsigned char)(i * 131 >> 3);
+        auto request = [](const std::string& path, std::vector<unsigned char> data,
+                          AsyncIoService::Mode mode, AsyncIoService::Fsync fsync) {
+            AsyncIoService::Request r;
+            r.path = path;
+            r.data = std::move(data);
+            r.mode = mode;
+            r.fsync = fsync;
+            return r;
+        };
+        int failures = 0;
+        std::mutex m;
+        std::vector<AsyncIoService::Request> batch;
+        batch.push_back(request(a, big, AsyncIoService::Mode::Truncate, AsyncIoService::Fsync::Never));
+        batch.push_back(request(a, {1, 2, 3}, AsyncIoService::Mode::Append, AsyncIoService::Fsync::Always));
+        batch.push_back(request(b, {4, 5}, AsyncIoService::Mode::Append, AsyncIoService::Fsync::Interval));
+        batch.push_back(request(a, big, AsyncIoService::Mode::Append, AsyncIoService::Fsync::Interval));
+        batch.push_back(request(b, {6}, AsyncIoService::Mode::Append, AsyncIoService::Fsync::Interval));
+        for (AsyncIoService::Request& r : batch)
+            r.done = [&](bool res) { std::lock_guard<std::mutex> lock(m); failures += !res; };
+        io.submitBatch(batch);
+        bool ok = io.submitAndWait(request(b, {7}, AsyncIoService::Mode::Append, AsyncIoService::Fsync::Always));
+        io.drain();
+
+        auto read = [](const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            return std::vector<unsigned char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        };
+        want = big;
+        want.insert(want.end(), {1, 2, 3});
+        want.insert(want.end(), big.begin(), big.end());
+        ok = ok && failures == 0 && read(a) == want && read(b) == std::vector<unsigned char>{4, 5, 6, 7};
+        std::remove(a.c_str());
+        std::remove(b.c_str());
+        AsyncIoService::Metrics mt = io.metrics();
+        check("async io: batched writes and fsync policies", ok && mt.syncs >= 2 && mt.syncErrors == 0);
+    }
+
+    return failed ? 1 : 0;
+}
+
+// ARENA MODE: sapper --arena N [preset] [bot]
+// Пробел — приостановить просмотр (сравнить скорость симулятора), Esc — назад/выход
+
+static int runArena(sf::RenderWindow& window, sf::Font& font, const ITheme& theme,
+                    int count, const GamePreset& p, const std::string& botName)
+{
+    if (!makeBotPolicy(botName, 0)) { std::printf("unknown bot %s\n", botName.c_str()); return 1; }
+    ArenaSimulation sim(p, count, botName);
+    sf::Vector2u size = window.getSize();
+    ArenaView view(sim, font, theme, sf::FloatRect(10, 40, (float)size.x - 20, (float)size.y - 50));
+    window.setFramerateLimit(30);
+
+    sf::Text stats("", font, 18);
+    stats.setFillColor(sf::Color::Black);
+    stats.setPosition(10, 8);
+
+    bool watching = true;
+    sf::Clock rateClock, total;
+    std::uint64_t lastGames = 0;
+    double rate = 0.0;
+    while (window.isOpen()) {
+        sf::Event e;
+        while (window.pollEvent(e)) {
+            if (e.type == sf::Event::Closed) window.close();
+            if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::Escape) {
+                if (view.zoomedIn()) view.unzoom();
+                else window.close();
+            }
+            if (e.type == sf::Event::KeyPressed && e.key.code == sf::Keyboard::Space) watching = !watching;
+            if (e.type == sf::Event::MouseButtonPressed) view.click(e.mouseButton.x, e.mouseButton.y);
+        }
+
+        float sec = rateClock.getElapsedTime().asSeconds();
+        if (sec >= 1.0f) {
+            rate = (sim.gamesPlayed() - lastGames) / sec;
+            lastGames = sim.gamesPlayed();
+            rateClock.restart();
+        }
+        std::uint64_t games = sim.gamesPlayed();
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "%d x %dx%d/%d, %s: %llu games, %.1f%% won, %.0f games/s%s",
+                      count, p.W, p.H, p.MINES, botName.c_str(), (unsigned long long)games,
+                      games ? 100.0 * sim.gamesWon() / games : 0.0, rate, watching ? "" : " (paused view)");
+        stats.setString(buf);
+
+        window.clear(theme.bgColor());
+        if (watching) {
+            view.update();   // снимки, сделанные по прошлой просьбе
+            view.request();
+        }
+        view.draw(window);
+        window.draw(stats);
+        window.display();
+    }
+
+    float sec = total.getElapsedTime().asSeconds();
+    std::printf("%llu games, %.1f%% won, %.0f games/s\n", (unsigned long long)sim.gamesPlayed(),
+                sim.gamesPlayed() ? 100.0 * sim.gamesWon() / sim.gamesPlayed() : 0.0,
+                sec > 0 ? sim.gamesPlayed() / sec : 0.0);
+    return 0;
+}
+
 // MAIN (SFML entry point)
 
-int main() {
+int main(int argc, char** argv) {
+    // Ключи памяти и записи перед режимом:
+    // sapper [--huge-pages thp|explicit] [--pin-workers] [--memory-limit MB]
+    //        [--io uring|threads] [--sync-interval MS] [режим ...]
+    MemoryPlacement& placement = MemoryPlacement::instance();
+    size_t memoryLimit = 0;
+    while (argc > 1) {
+        std::string opt = argv[1];
+        int used = 1;
+        if (opt == "--pin-workers") {
+            placement.pinWorkers = true;
+        } else if (opt == "--memory-limit" && argc > 2) {
+            memoryLimit = (size_t)std::max(0, std::atoi(argv[2])) << 20;
+            used = 2;
+        } else if (opt == "--huge-pages" && argc > 2) {
+            std::string mode = argv[2];
+            placement.boardPages = mode == "explicit" ? MemoryPlacement::Pages::Explicit
+                                 : mode == "thp"      ? MemoryPlacement::Pages::Transparent
+                                                      : MemoryPlacement::Pages::Normal;
+            used = 2;
+        } else if (opt == "--io" && argc > 2) {
+            AsyncIoService::options().backend = std::string(argv[2]) == "threads"
+                ? AsyncIoService::Backend::Threads : AsyncIoService::Backend::IoUring;
+            used = 2;
+        } else if (opt == "--sync-interval" && argc > 2) {
+            AsyncIoService::options().syncIntervalMs = std::max(0, std::atoi(argv[2]));
+            used = 2;
+        } else {
+            break;
+        }
+        for (int k = 0; k < used; k++) { argv[1] = argv[0]; argv++; argc--; }
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--analyze-openings")
+        return runOpeningAnalysis(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--tournament")
+        return runTournament(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--bench-evaluator")
+        return runEvaluatorBench(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--export-dataset")
+        return runDatasetExport(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--validate-replays")
+        return runReplayValidation(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--archive-boards")
+        return runBoardArchive(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--export-video")
+        return runVideoExport(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--bench-storage")
+        return runStorageBench(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--board-file")
+        return runBoardFile(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--bench-memory")
+        return runMemoryBench(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--self-test")
+        return runSelfTest(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--bench-render")
+        return runRenderBench(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "--memory-report")
+        return runMemoryReport(argc, argv, memoryLimit);
+
+    // sapper --target-3bv N — доски под заданную сложность
+    // sapper --board <file> — фиксированное поле из файла (меню пропускается)
+    // sapper --ui-scale K — масштаб интерфейса (по умолчанию — по экрану)
+    int target3bv = 0;
+    std::string boardPath;
+    float uiScale = 0.0f;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--target-3bv") target3bv = std::atoi(argv[i + 1]);
+        if (std::string(argv[i]) == "--board") boardPath = argv[i + 1];
+        if (std::string(argv[i]) == "--ui-scale") uiScale = (float)std::atof(argv[i + 1]);
+    }
+
+    std::unique_ptr<FileBoardGenerator> fileBoard;
+    if (!boardPath.empty()) {
+        std::string err;
+        BoardPlanes planes;
+        sf::Clock loadClock;
+        if (!loadMineMap(boardPath, planes, err)) {
+            std::printf("%s: %s\n", boardPath.c_str(), err.c_str());
+            return 1;
+        }
+        fileBoard = std::make_unique<FileBoardGenerator>(std::move(planes));
+        BoardVerifier::Report check = BoardVerifier().verify(fileBoard->board(), fileBoard->numberPlane().data());
+        std::printf("%s: %dx%d, %d mines, loaded and verified in %.1f ms: %s\n", boardPath.c_str(),
+                    fileBoard->board().W, fileBoard->board().H, fileBoard->board().mineCount(),
+                    loadClock.getElapsedTime().asSeconds() * 1000.0f, check.describe().c_str());
+        if (!check.ok()) return 1;
+    }
+
     sf::Font font;
 
-    if (!font.loadFromFile("C:\\Windows\\Fonts\\arial.ttf")) {
+    if (!loadUiFont(font)) {
         printf("Не удалось загрузить шрифт!\n");
         return -1;
     }
 
+    // Окно 800x800 в масштабе интерфейса, но не больше рабочего стола
     Layout layout;
+    bool fixedScale = uiScale > 0.0f;
+    if (!fixedScale) uiScale = detectUiScale();
+    sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
+    layout.resize(std::min((int)(layout.WINDOW_W * uiScale), (int)desktop.width),
+                  std::min((int)(layout.WINDOW_H * uiScale), (int)desktop.height), uiScale);
 
     // SFML: создаём окно
     sf::RenderWindow window(sf::VideoMode(layout.WINDOW_W, layout.WINDOW_H), "Minesweeper");
@@ -765,49 +7598,103 @@ int main() {
     // ThemeFactory: создаём тему (цвета/размеры) через фабрику
     auto theme = ThemeFactory::makeDefault();
 
+    if (argc > 2 && std::string(argv[1]) == "--arena")
+        return runArena(window, font, *theme, std::max(1, std::atoi(argv[2])),
+                        parsePresets(argc > 3 ? argv[3] : "30x16x99").front(), argc > 4 ? argv[4] : "solver");
+
+    // Кэш анализа первых кликов (если был запуск --analyze-openings)
+    OpeningTable openings[3];
+    for (int c = 1; c <= 3; c++) {
+        GamePreset p = presetByDifficulty(c);
+        openings[c - 1].load(OpeningTable::cachePath(p.W, p.H, p.MINES));
+    }
+
     // SFML: меню выбора сложности
     SfmlMenuScreen menu(font, *theme);
-    int choice = menu.run(window);
-    if (choice == 0) return 0;
-
-    // Создаём игру выбранной сложности
-    Game game = makeGameByDifficulty(choice);
+    for (int c = 1; c <= 3; c++) menu.setPreview(c, &openings[c - 1]);
+    bool fixedBoard = !boardPath.empty();
+    int choice = fixedBoard ? 0 : menu.run(window);
+    if (choice == 0 && !fixedBoard) return 0;
+
+    // Создаём игру выбранной сложности (или под поле из файла)
+    Game game = fixedBoard
+        ? Game(fileBoard->board().W, fileBoard->board().H, fileBoard->board().mineCount(),
+               std::make_unique<DefaultCellFactory>(), std::move(fileBoard))
+        : makeGameByDifficulty(choice, target3bv);
     layout.recompute(game);
 
-    // SFML: создаём UI элементы (кнопки и тексты)
+    // SFML: создаём UI элементы (кнопки и тексты); места и размеры — placeHud
     UiWidgets ui;
 
-    ui.status = sf::Text("", font, theme->hudTitleSize());
+    ui.status = sf::Text("", font);
     ui.status.setFillColor(theme->statusColor());
-    ui.status.setPosition(180, 5);
 
-    ui.restartBtn = sf::RectangleShape(sf::Vector2f(150, 40));
     ui.restartBtn.setFillColor(sf::Color(200, 200, 200));
-    ui.restartBtn.setPosition(600, 10);
-
-    ui.restartText = sf::Text("Restart", font, 20);
+    ui.restartText = sf::Text("Restart", font);
     ui.restartText.setFillColor(sf::Color::Black);
-    ui.restartText.setPosition(630, 15);
 
-    ui.menuBtn = sf::RectangleShape(sf::Vector2f(150, 40));
     ui.menuBtn.setFillColor(sf::Color(200, 200, 200));
-    ui.menuBtn.setPosition(440, 10);
-
-    ui.menuText = sf::Text("Menu", font, 20);
+    ui.menuText = sf::Text("Menu", font);
     ui.menuText.setFillColor(sf::Color::Black);
-    ui.menuText.setPosition(485, 15);
 
-    ui.minesIndicator = sf::Text("", font, theme->hudSmallSize());
+    ui.minesIndicator = sf::Text("", font);
     ui.minesIndicator.setFillColor(sf::Color::Black);
-    ui.minesIndicator.setPosition(440, 60);
 
-    ui.timerText = sf::Text("", font, theme->hudSmallSize());
+    ui.timerText = sf::Text("", font);
     ui.timerText.setFillColor(sf::Color::Black);
-    ui.timerText.setPosition(440, 82);
+
+    ui.debugText = sf::Text("", font);
+    ui.debugText.setFillColor(sf::Color::Black);
+    ui.debugText.setPosition(10, 10);
+    ui.debugPanel.setFillColor(sf::Color(255, 255, 255, 220));
+    placeHud(layout, *theme, ui);
 
     // Создаём рендерер и контроллер ввода:
-    SfmlRenderer renderer(font, *theme);// работает с SFML draw()
-    SfmlInputController input;// работает с SFML events
+    // Шейдерный рендерер (одна текстура состояния), без шейдеров — SfmlRenderer
+    std::unique_ptr<IRenderer> renderer = makeBoardRenderer(font, *theme, layout.CELL);
+    // Повторы: у каждой партии своё зерно, чтобы её можно было пересчитать
+    std::random_device entropy;
+    ReplayRecorder recorder("replays.txt");
+    auto startRecording = [&] {
+        game.events.subscribe(&recorder); // партия могла быть заменена
+        std::uint32_t seed = entropy();
+        game.boardGenerator->reseed(seed);
+        recorder.begin(game, target3bv, seed);
+        if (fixedBoard) recorder.cancel(); // по зерну такое поле не восстановить
+    };
+    startRecording();
+
+    SfmlInputController input(&recorder);// работает с SFML events
+    DefaultSolver solver;// подсказки по клавише H
+
+    // Память подсистем: отладочный слой (F3), дамп (F4), предел --memory-limit.
+    // Кэши сбрасываются от дешёвых к дорогим: пул буферов записи,
+    // решатель (пересчитает выводы), копия поля в рендерере (перезагрузит текстуру)
+    MemoryBudget budget(memoryLimit);
+    budget.addCache("async io pool", [] { return AsyncIoService::instance().trimPool(); });
+    budget.addCache("solver", [&] { return solver.releaseCaches(); });
+    budget.addCache("renderer", [&] { return renderer->releaseCaches(); });
+    auto memoryUsage = [&] {
+        size_t tables = 0;
+        for (const OpeningTable& t : openings) tables += t.bytes();
+        return processMemoryUsage({game.memoryUsage(), renderer->memoryUsage(), solver.memoryUsage(),
+                                   recorder.memoryUsage(), MemoryUsage("opening tables", tables),
+                                   AsyncIoService::instance().memoryUsage()});
+    };
+    float memoryCheckTimer = 0.0f;
+
+    // Раскладка после смены поля или размера окна: HUD, вид окна (1 px = 1
+    // единица, без растяжения) и то, что рендерер кэширует под размер клетки
+    auto applyLayout = [&] {
+        layout.recompute(game);
+        placeHud(layout, *theme, ui);
+        window.setView(sf::View(sf::FloatRect(0, 0, (float)layout.WINDOW_W, (float)layout.WINDOW_H)));
+        renderer->onLayoutChanged(layout);
+    };
+    // Пока тянут рамку, Resized идут потоком — раскладка пересобирается
+    // один раз, когда размер не менялся 150 мс
+    sf::Vector2u pendingSize;
+    float resizeTimer = -1.0f;
 
     // SFML: clock для dt (дельта времени на кадр)
     sf::Clock frameClock;
@@ -818,25 +7705,94 @@ int main() {
         // Логика игры обновляется отдельно от отрисовки
         game.update(dt);
 
+        // Раз в полсекунды: предел памяти и строки отладочного слоя
+        memoryCheckTimer -= dt;
+        if (memoryCheckTimer <= 0.0f && (budget.limitBytes() || ui.debugVisible)) {
+            memoryCheckTimer = 0.5f;
+            MemoryUsage usage = memoryUsage();
+            if (budget.enforce(usage)) usage = memoryUsage();
+            if (ui.debugVisible) {
+                std::string text;
+                usage.describe(text);
+                if (budget.limitBytes())
+                    text += "limit " + std::to_string(budget.limitBytes() >> 20) + " MB, evictions "
+                          + std::to_string(budget.evictionCount()) + ", freed "
+                          + std::to_string(budget.freedBytes() >> 10) + " KB\n";
+                ui.debugText.setString(text);
+                sf::FloatRect r = ui.debugText.getGlobalBounds();
+                ui.debugPanel.setPosition(r.left - 4, r.top - 4);
+                ui.debugPanel.setSize(sf::Vector2f(r.width + 8, r.height + 8));
+            }
+        }
+
         // SFML: обработка очереди событий
         sf::Event e;
         while (window.pollEvent(e)) {
+            if (e.type == sf::Event::Resized) {
+                pendingSize = sf::Vector2u(e.size.width, e.size.height);
+                resizeTimer = 0.15f;
+                continue;
+            }
             AppAction action = input.handleEvent(window, e, game, layout, ui);
 
             // Реакции приложения на кнопки
             if (action.type == AppActionType::Restart) {
                 game.resetField();
-                layout.recompute(game);
+                applyLayout();
+                startRecording();
             } else if (action.type == AppActionType::BackToMenu) {
                 int newChoice = menu.run(window);
                 if (newChoice == 0) return 0;
-                game = makeGameByDifficulty(newChoice);
-                layout.recompute(game);
+                fixedBoard = false;
+                game = makeGameByDifficulty(newChoice, target3bv);
+                applyLayout();
+                startRecording();
+            } else if (action.type == AppActionType::ToggleDebug) {
+                ui.debugVisible = !ui.debugVisible;
+                memoryCheckTimer = 0.0f;
+            } else if (action.type == AppActionType::DumpMemory) {
+                std::string json = memoryUsage().toJson() + "\n";
+                AsyncIoService::Request r;
+                r.path = "memory.json";
+                r.data.assign(json.begin(), json.end());
+                r.mode = AsyncIoService::Mode::Truncate;
+                AsyncIoService::instance().submit(std::move(r));
+            } else if (action.type == AppActionType::SaveSnapshot) {
+                saveSnapshot(game, "snapshot.mss");
+            } else if (action.type == AppActionType::LoadSnapshot) {
+                if (loadSnapshot(game, "snapshot.mss")) {
+                    applyLayout();
+                    recorder.cancel();
+                }
+            } else if (action.type == AppActionType::Hint) {
+                // Первый ход — лучшая клетка из анализа дебютов;
+                // дальше решатель: открыть безопасную клетку или пометить мину
+                Deduction d;
+                const OpeningTable* table = nullptr;
+                for (const OpeningTable& t : openings)
+                    if (t.matches(game.W, game.H, game.MINES)) table = &t;
+                if (game.gameOver || game.win) {
+                    // партия окончена — подсказывать нечего
+                } else if (game.firstClick && table && table->bestCell() >= 0) {
+                    int best = table->bestCell();
+                    recorder.record('H', best % game.W, best / game.W);
+                    game.leftClickCell(best % game.W, best / game.W);
+                } else if (solver.nextMove(game, d)) {
+                    recorder.record(d.mine ? 'G' : 'H', d.x, d.y);
+                    if (d.mine) game.rightClickCell(d.x, d.y);
+                    else        game.leftClickCell(d.x, d.y);
+                }
             }
         }
 
+        if (resizeTimer >= 0.0f && (resizeTimer -= dt) < 0.0f) {
+            layout.resize((int)pendingSize.x, (int)pendingSize.y, fixedScale ? layout.scale : detectUiScale());
+            applyLayout();
+        }
+
         // SFML: рисуем кадр
-        renderer.render(window, game, layout, ui);
+        renderer->render(window, game, layout, ui);
+        window.display();
     }
 
     return 0;